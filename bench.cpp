@@ -0,0 +1,242 @@
+// benchmark suite, a separate program from main.cpp: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// sweeps graph sizes, false +ve targets, cache capacities and query distributions and measures every search on every combination
+// the results are written as CSV and/or JSON so that the comparison in bench.pdf can be regenerated and tracked across builds
+#include <chrono>
+#include <cstdlib>	 // strtod
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "divisor_graph.hpp"
+#include "query_benchmark.hpp"
+using namespace std;
+
+// FILTER_ONLY_SEARCH only asks the node filter, so its latency and its positives are those of the filter alone
+// LABEL_SEARCH answers from the prime label index, which is built the first time a graph is queried with it
+enum SearchMode { BASELINE_DFS_SEARCH, DFS_SEARCH, FILTER_PRUNED_DFS_SEARCH, BLOOM_FILTER_SEARCH, FILTER_ONLY_SEARCH, LABEL_SEARCH };
+
+const char *searchModeName(const SearchMode mode) {
+	return mode == BASELINE_DFS_SEARCH ? "baseline_dfs"
+		   : mode == DFS_SEARCH ? "dfs"
+		   : mode == FILTER_PRUNED_DFS_SEARCH ? "filter_dfs"
+		   : mode == BLOOM_FILTER_SEARCH ? "bloom"
+		   : mode == FILTER_ONLY_SEARCH ? "filter"
+		   : "labels";
+}
+
+struct BenchConfig {
+	vector<int> nodeCounts = {20001, 200001, 1000001};
+	vector<double> falsePositivityRatesInPC = {1};
+	vector<double> cacheLenLimitsInPC = {0, 1};	 // cache capacity as a percentage of the node count, like CACHE_LEN_LIMIT in main.cpp
+	vector<QueryDistribution> distributions = {UNIFORM_QUERIES, ZIPF_QUERIES, NEGATIVE_QUERIES, POSITIVE_QUERIES};
+	vector<SearchMode> modes = {DFS_SEARCH, BLOOM_FILTER_SEARCH};
+	vector<NodeFilterType> filterTypes = {STANDARD_BLOOM_FILTER};
+	vector<int> exactSettings = {0};  // 1 gives the small nodes exact sets in front of the filter
+	int queryCount = 200000, warmupRounds = 1, repetitions = 5;
+	string csvPath = "-", jsonPath;	 // "-" is stdout, an empty path is not written
+};
+
+struct BenchResult {
+	int nodes;
+	double falsePositivityRateInPC;
+	const char *filter;
+	bool exact;
+	int cacheLenLimit;
+	const char *distribution, *mode;
+	double buildMs;
+	size_t graphBytes, filterBytes, cacheBytes, indexBytes;
+	double filterBitsPerKey;
+	LatencySummary latency;
+};
+
+// splits "a,b,c" and parses every item with parse, returns false if any item is rejected
+template <typename T, typename Parse>
+bool parseList(const string &text, vector<T> &values, Parse parse) {
+	values.clear();
+	stringstream items(text);
+	for (string item; getline(items, item, ',');) {
+		T value;
+		if (not parse(item, value)) return false;
+		values.push_back(value);
+	}
+	return not values.empty();
+}
+
+bool parseNumber(const string &text, double &value) {
+	char *end;
+	value = strtod(text.c_str(), &end);
+	return not text.empty() and *end == '\0' and value >= 0;
+}
+
+// a false +ve target in %, with the same bounds as the fpp setting of main.cpp
+bool parseRate(const string &text, double &value) { return parseNumber(text, value) and value > 0 and value < 100; }
+
+bool parseCount(const string &text, int &value) {
+	double parsed;
+	if (not parseNumber(text, parsed) or parsed > 1e9) return false;
+	value = parsed;
+	return true;
+}
+
+bool parseFlag(const string &text, int &value) { return parseCount(text, value) and value <= 1; }
+
+// a graph of 2 nodes has no pair where x is not a factor of y, so the negative distribution could never be generated
+bool parseNodeCount(const string &text, int &value) { return parseCount(text, value) and value >= 3; }
+
+bool parseSearchMode(const string &text, SearchMode &mode) {
+	for (const SearchMode candidate: {BASELINE_DFS_SEARCH, DFS_SEARCH, FILTER_PRUNED_DFS_SEARCH, BLOOM_FILTER_SEARCH, FILTER_ONLY_SEARCH, LABEL_SEARCH})
+		if (text == searchModeName(candidate)) {
+			mode = candidate;
+			return true;
+		}
+	return false;
+}
+
+void printUsage(const char *program) {
+	cerr << "Usage: " << program << " [options]\n"
+		 << "  --nodes 20001,200001,1000001         graph sizes\n"
+		 << "  --fpp 1                              false +ve targets of the bloom filters in %\n"
+		 << "  --cache 0,1                          false +ve cache capacities in % of the graph size\n"
+		 << "  --distributions uniform,zipf,negative,positive\n"
+		 << "  --modes dfs,bloom                    baseline_dfs is available too but explodes on large graphs, filter only asks the node filter,\n"
+		 << "                                       filter_dfs skips the subtrees that the node filters rule out, labels uses the prime label index\n"
+		 << "  --filters standard                   any of standard,blocked,counting,cuckoo,fuse\n"
+		 << "  --exact 0                            0,1 compares the filters with and without exact sets for the small nodes\n"
+		 << "  --queries 200000 --warmup 1 --repetitions 5\n"
+		 << "  --csv <file or - for stdout>         default -\n"
+		 << "  --json <file or - for stdout>        not written by default" << endl;
+}
+
+bool parseArguments(const int argc, char *argv[], BenchConfig &config) {
+	for (int i = 1; i < argc; i++) {
+		const string option = argv[i];
+		if (i + 1 == argc) return false;
+		const string value = argv[++i];
+
+		bool parsed;
+		if (option == "--nodes") parsed = parseList(value, config.nodeCounts, parseNodeCount);
+		else if (option == "--fpp") parsed = parseList(value, config.falsePositivityRatesInPC, parseRate);
+		else if (option == "--cache") parsed = parseList(value, config.cacheLenLimitsInPC, parseNumber);
+		else if (option == "--distributions") parsed = parseList(value, config.distributions, parseDistribution);
+		else if (option == "--modes") parsed = parseList(value, config.modes, parseSearchMode);
+		else if (option == "--filters") parsed = parseList(value, config.filterTypes, parseFilterType);
+		else if (option == "--exact") parsed = parseList(value, config.exactSettings, parseFlag);
+		else if (option == "--queries") parsed = parseCount(value, config.queryCount) and config.queryCount >= 1;
+		else if (option == "--warmup") parsed = parseCount(value, config.warmupRounds);
+		else if (option == "--repetitions") parsed = parseCount(value, config.repetitions) and config.repetitions >= 1;
+		else if (option == "--csv") config.csvPath = value, parsed = true;
+		else if (option == "--json") config.jsonPath = value, parsed = true;
+		else parsed = false;
+		if (not parsed) return false;
+	}
+	return true;
+}
+
+void writeCSV(ostream &out, const vector<BenchResult> &results) {
+	out << "nodes,fpp_pc,filter,exact,cache_entries,distribution,mode,build_ms,graph_bytes,filter_bytes,filter_bits_per_key,cache_bytes,index_bytes,positives,mean_ns,p50_ns,p99_ns,p999_ns,"
+		   "queries_per_second\n";
+	for (const BenchResult &r: results)
+		out << r.nodes << "," << r.falsePositivityRateInPC << "," << r.filter << "," << r.exact << "," << r.cacheLenLimit << "," << r.distribution << "," << r.mode << "," << r.buildMs
+			<< "," << r.graphBytes << "," << r.filterBytes << "," << r.filterBitsPerKey << "," << r.cacheBytes << "," << r.indexBytes << "," << r.latency.positives << "," << r.latency.meanNs << ","
+			<< r.latency.p50Ns << "," << r.latency.p99Ns << "," << r.latency.p999Ns << "," << (long long)r.latency.queriesPerSecond << "\n";
+}
+
+void writeJSON(ostream &out, const BenchConfig &config, const vector<BenchResult> &results) {
+	out << "{\n  \"queries\": " << config.queryCount << ", \"warmup\": " << config.warmupRounds << ", \"repetitions\": " << config.repetitions
+		<< ", \"threads\": " << workerCount() << ",\n  \"results\": [";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult &r = results[i];
+		out << (i ? "," : "") << "\n    {\"nodes\": " << r.nodes << ", \"fpp_pc\": " << r.falsePositivityRateInPC << ", \"filter\": \"" << r.filter
+			<< "\", \"exact\": " << (r.exact ? "true" : "false") << ", \"cache_entries\": " << r.cacheLenLimit
+			<< ", \"distribution\": \"" << r.distribution << "\", \"mode\": \"" << r.mode << "\", \"build_ms\": " << r.buildMs << ", \"graph_bytes\": " << r.graphBytes
+			<< ", \"filter_bytes\": " << r.filterBytes << ", \"filter_bits_per_key\": " << r.filterBitsPerKey << ", \"cache_bytes\": " << r.cacheBytes << ", \"index_bytes\": " << r.indexBytes << ", \"positives\": " << r.latency.positives
+			<< ", \"mean_ns\": " << r.latency.meanNs << ", \"p50_ns\": " << r.latency.p50Ns << ", \"p99_ns\": " << r.latency.p99Ns
+			<< ", \"p999_ns\": " << r.latency.p999Ns << ", \"queries_per_second\": " << (long long)r.latency.queriesPerSecond << "}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+// writes to path, or to stdout if path is "-"
+bool writeOutput(const string &path, const function<void(ostream &)> &write) {
+	if (path.empty()) return true;
+	if (path == "-") {
+		write(cout);
+		return true;
+	}
+	ofstream file(path);
+	if (not file) {
+		cerr << "Cannot open " << path << endl;
+		return false;
+	}
+	write(file);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	BenchConfig config;
+	if (not parseArguments(argc, argv, config)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	vector<BenchResult> results;
+	for (const int nodes: config.nodeCounts)
+		for (const double falsePositivityRateInPC: config.falsePositivityRatesInPC)
+			for (const NodeFilterType filterType: config.filterTypes)
+				for (const int exact: config.exactSettings) {
+					// the graph and the filters only depend on the size, the false +ve target, the filter and the exact sets, every cache capacity and workload reuses them
+					GraphConfig graphConfig;
+					graphConfig.totalNodes = nodes;
+					graphConfig.falsePositivityRateInPC = falsePositivityRateInPC;
+					graphConfig.cacheLenLimit = 0;
+					graphConfig.filterType = filterType;
+					graphConfig.exactSmallNodes = exact;
+					DivisorGraph graph(graphConfig);
+					const double buildMs = chrono::duration<double, milli>(graph.build()).count();
+					const NodeFilterBank &filters = graph.filters();
+					const double filterBitsPerKey = 8.0 * filters.memoryUsage() / filters.keyCount();
+					cerr << "Built " << nodes << " nodes at " << falsePositivityRateInPC << "% false +ve with " << filters.name() << " in " << buildMs << " Milliseconds, "
+						 << filterBitsPerKey << " Bits/Key" << endl;
+
+					for (const QueryDistribution distribution: config.distributions) {
+						const vector<Query> queries = generateQueries(distribution, nodes, config.queryCount);
+
+						for (const SearchMode mode: config.modes)
+							for (const double cacheLenLimitInPC: config.cacheLenLimitsInPC) {
+								if (mode != BLOOM_FILTER_SEARCH and cacheLenLimitInPC != config.cacheLenLimitsInPC.front()) continue;	 // only [2] touches the cache
+								const int cacheLenLimit = cacheLenLimitInPC * nodes / 100;
+								graph.resizeCache(cacheLenLimit);  // every measurement starts from an empty cache that only its own warmup fills
+
+								LatencySummary latency;
+								if (mode == BLOOM_FILTER_SEARCH)
+									latency = measureLatency(queries, config.warmupRounds, config.repetitions, [&](const int x, const int y) { return graph.searchUsingBloomFilter(x, y); });
+								else if (mode == LABEL_SEARCH) {
+									if (not graph.labelled())
+										cerr << "  Labelled the nodes in " << chrono::duration<double, milli>(graph.labelNodes()).count() << " Milliseconds, "
+											 << graph.labels().memoryUsage() << " Bytes" << endl;
+									latency = measureLatency(queries, config.warmupRounds, config.repetitions, [&](const int x, const int y) { return graph.searchUsingLabels(x, y); });
+								} else if (mode == FILTER_ONLY_SEARCH)
+									latency = measureLatency(queries, config.warmupRounds, config.repetitions, [&](const int x, const int y) { return filters.contains(y, x); });
+								else {
+									const DFSMode dfsMode = mode == BASELINE_DFS_SEARCH ? BASELINE_DFS : mode == FILTER_PRUNED_DFS_SEARCH ? FILTER_PRUNED_DFS : PRUNED_DFS;
+									latency = measureLatency(queries, config.warmupRounds, config.repetitions, [&](const int x, const int y) { return graph.searchUsingDFS(x, y, dfsMode); });
+								}
+
+								results.push_back(BenchResult{nodes, falsePositivityRateInPC, filterTypeName(filterType), exact == 1, mode == BLOOM_FILTER_SEARCH ? cacheLenLimit : 0,
+															  distributionName(distribution), searchModeName(mode), buildMs, graph.compressedGraph().memoryUsage(),
+															  filters.memoryUsage(), graph.cache().memoryUsage(), mode == LABEL_SEARCH ? graph.labels().memoryUsage() : 0,
+															  filterBitsPerKey, latency});
+								cerr << "  " << distributionName(distribution) << " " << searchModeName(mode) << " cache " << results.back().cacheLenLimit << ": p50 "
+									 << latency.p50Ns << " p99 " << latency.p99Ns << " p999 " << latency.p999Ns << " Nanoseconds, " << (long long)latency.queriesPerSecond
+									 << " Queries/Second" << endl;
+							}
+					}
+				}
+
+	const bool written = writeOutput(config.csvPath, [&](ostream &out) { writeCSV(out, results); }) and
+						 writeOutput(config.jsonPath, [&](ostream &out) { writeJSON(out, config, results); });
+	return written ? 0 : 1;
+}
@@ -23,11 +23,23 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <iterator>
 #include <limits>
+#include <map>
+#include <new>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BLOOM_FILTER_X86_BATCH 1
+#include <immintrin.h>
+#else
+#define BLOOM_FILTER_X86_BATCH 0
+#endif
+
 
 static const std::size_t bits_per_char = 0x08;    // 8 bits in 1 char(unsigned)
 
@@ -42,6 +54,60 @@ static const unsigned char bit_mask[bits_per_char] = {
                                                        0x80   //10000000
                                                      };
 
+enum bloom_hash_scheme
+{
+   /*
+     Note:
+     salted_ap_hash runs the AP hash over the whole key once for every
+     salt, so the cost of insert and contains grows with the number of
+     hashes. double_hashing_mix64 mixes the key into a single 64 bit
+     hash and derives all k indices from its two 32 bit halves with
+     Kirsch-Mitzenmacher double hashing, h1 + i * h2, so hashing costs
+     the same no matter how many hashes are used.
+   */
+   salted_ap_hash,
+   double_hashing_mix64
+};
+
+enum bloom_index_scheme
+{
+   /*
+     Note:
+     How a 32 bit probe hash is reduced to a bit of the table.
+     modulo_index divides by the table size on every probe.
+     power_of_two_index rounds the table size up to a power of two and
+     masks the hash. fastrange_index keeps the table size and maps the
+     hash with a multiply and a shift, (hash * table_size) >> 32, which
+     requires tables smaller than 2^32 bits. fastrange_index relies on
+     the upper bits of the hash, which the AP hash of short keys barely
+     uses, so it should be paired with double_hashing_mix64.
+     Scaling the double hashing probes h1 + i * h2 down to the table
+     maps them to the same bit whenever h2 / 2^32 is close to a fraction
+     with a small denominator, which for tables of a few dozen bits
+     repeats a bit for up to a third of the keys. So with double hashing fastrange_index
+     only maps h1 and h2 to the table and runs enhanced double hashing
+     on the indices themselves, wrapping by subtraction instead of
+     dividing. See bloom_filter::probe_sequence.
+   */
+   modulo_index,
+   power_of_two_index,
+   fastrange_index
+};
+
+enum bloom_filter_layout
+{
+   /*
+     Note:
+     The kind of a filter of a bloom_filter_bank. standard_layout
+     filters answer like a bloom_filter, blocked_layout ones like a
+     blocked_bloom_filter and counting_layout ones like a
+     counting_bloom_filter, which is the only layout supporting erase.
+   */
+   standard_layout,
+   blocked_layout,
+   counting_layout
+};
+
 class bloom_parameters
 {
 public:
@@ -53,7 +119,9 @@ public:
      maximum_number_of_hashes(std::numeric_limits<unsigned int>::max()),
      projected_element_count(10000),
      false_positive_probability(1.0 / projected_element_count),
-     random_seed(0xA5A5A5A55A5A5A5AULL)
+     random_seed(0xA5A5A5A55A5A5A5AULL),
+     hash_scheme(salted_ap_hash),
+     index_scheme(modulo_index)
    {}
 
    virtual ~bloom_parameters()
@@ -92,6 +160,14 @@ public:
 
    unsigned long long int random_seed;
 
+   // How the indices of a key are hashed, see bloom_hash_scheme.
+   // The default is the original salted AP hash.
+   bloom_hash_scheme hash_scheme;
+
+   // How probe hashes are reduced to table indices, see bloom_index_scheme.
+   // The default is the original modulo of the table size.
+   bloom_index_scheme index_scheme;
+
    struct optimal_parameters_t
    {
       optimal_parameters_t()
@@ -118,14 +194,92 @@ public:
       if (!(*this))
          return false;
 
+      const std::pair<double, double> min_k_m = search_optimal_parameters(projected_element_count, false_positive_probability);
+
+      const double min_k = min_k_m.first;
+      const double min_m = min_k_m.second;
+
+      optimal_parameters_t& optp = optimal_parameters;
+
+      optp.number_of_hashes = static_cast<unsigned int>(min_k);
+
+      optp.table_size = static_cast<unsigned long long int>(min_m);
+
+      optp.table_size += (((optp.table_size % bits_per_char) != 0) ? (bits_per_char - (optp.table_size % bits_per_char)) : 0);
+
+      if (optp.number_of_hashes < minimum_number_of_hashes)
+         optp.number_of_hashes = minimum_number_of_hashes;
+      else if (optp.number_of_hashes > maximum_number_of_hashes)
+         optp.number_of_hashes = maximum_number_of_hashes;
+
+      if (optp.table_size < minimum_size)
+         optp.table_size = minimum_size;
+      else if (optp.table_size > maximum_size)
+         optp.table_size = maximum_size;
+
+      if (power_of_two_index == index_scheme)
+      {
+         unsigned long long int power_of_two = bits_per_char;
+
+         while (power_of_two < optp.table_size)
+            power_of_two <<= 1;
+
+         while ((power_of_two > maximum_size) && (power_of_two > bits_per_char))
+            power_of_two >>= 1;
+
+         optp.table_size = power_of_two;
+      }
+
+      return true;
+   }
+
+protected:
+
+   static inline std::pair<double, double> search_optimal_parameters(const unsigned long long int element_count, const double probability)
+   {
+      /*
+        Note:
+        Returns the k from 1 to 999 with the smallest table size
+        m(k) = -k n / ln(1 - p^(1/k)), and that m. m(k) has a single
+        minimum near k = ln(1/p) / ln(2), so for 0 < p < 1 only the
+        k within search_window of it are tried, in ascending order and
+        with the same expression, which picks exactly the k and m the
+        search over all 999 would. Every other p, including those so
+        small that 1 - p rounds to 1, still tries them all.
+        The results are cached per thread by (n, p), so the filters of
+        every bank built on the thread share them.
+      */
+      static const double search_window = 3.0;
+      static const std::size_t cache_limit = 1 << 16;
+
+      typedef std::map<std::pair<unsigned long long int, double>, std::pair<double, double> > cache_type;
+
+      static thread_local cache_type cache;
+
+      const std::pair<unsigned long long int, double> key(element_count, probability);
+
+      cache_type::const_iterator itr = cache.find(key);
+
+      if (cache.end() != itr)
+         return itr->second;
+
       double min_m  = std::numeric_limits<double>::infinity();
       double min_k  = 0.0;
       double k      = 1.0;
+      double last_k = 999.0;
+
+      if ((probability < 1.0) && ((1.0 - probability) < 1.0))
+      {
+         const double closed_form_k = -std::log(probability) / std::log(2.0);
 
-      while (k < 1000.0)
+         k      = std::max(1.0, std::floor(closed_form_k) - search_window);
+         last_k = std::min(last_k, std::ceil(closed_form_k) + search_window);
+      }
+
+      while (k <= last_k)
       {
-         const double numerator   = (- k * projected_element_count);
-         const double denominator = std::log(1.0 - std::pow(false_positive_probability, 1.0 / k));
+         const double numerator   = (- k * element_count);
+         const double denominator = std::log(1.0 - std::pow(probability, 1.0 / k));
 
          const double curr_m = numerator / denominator;
 
@@ -138,36 +292,392 @@ public:
          k += 1.0;
       }
 
-      optimal_parameters_t& optp = optimal_parameters;
+      if (cache.size() >= cache_limit)
+         cache.clear();
 
-      optp.number_of_hashes = static_cast<unsigned int>(min_k);
+      return cache[key] = std::make_pair(min_k, min_m);
+   }
 
-      optp.table_size = static_cast<unsigned long long int>(min_m);
+};
 
-      optp.table_size += (((optp.table_size % bits_per_char) != 0) ? (bits_per_char - (optp.table_size % bits_per_char)) : 0);
+template <typename T, std::size_t Alignment = 64>
+class bloom_aligned_allocator
+{
+   /*
+     Note:
+     Hands out Alignment byte aligned memory, so that a bit table
+     starts on a cache line and the vector loads of
+     bloom_table_algebra never split one.
+   */
 
-      if (optp.number_of_hashes < minimum_number_of_hashes)
-         optp.number_of_hashes = minimum_number_of_hashes;
-      else if (optp.number_of_hashes > maximum_number_of_hashes)
-         optp.number_of_hashes = maximum_number_of_hashes;
+public:
 
-      if (optp.table_size < minimum_size)
-         optp.table_size = minimum_size;
-      else if (optp.table_size > maximum_size)
-         optp.table_size = maximum_size;
+   typedef T value_type;
 
-      return true;
+   template <typename U>
+   struct rebind
+   {
+      typedef bloom_aligned_allocator<U, Alignment> other;
+   };
+
+   bloom_aligned_allocator()
+   {}
+
+   template <typename U>
+   bloom_aligned_allocator(const bloom_aligned_allocator<U, Alignment>&)
+   {}
+
+   inline T* allocate(const std::size_t n)
+   {
+      return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+   }
+
+   inline void deallocate(T* p, const std::size_t)
+   {
+      ::operator delete(p, std::align_val_t(Alignment));
+   }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+inline bool operator == (const bloom_aligned_allocator<T, Alignment>&, const bloom_aligned_allocator<U, Alignment>&)
+{
+   return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+inline bool operator != (const bloom_aligned_allocator<T, Alignment>&, const bloom_aligned_allocator<U, Alignment>&)
+{
+   return false;
+}
+
+class bloom_table_algebra
+{
+   /*
+     Note:
+     Word wide set algebra on two bit tables of the same size. The
+     widest kernel the CPU supports is picked at runtime: AVX-512
+     handles 64 bytes per iteration, AVX2 32 bytes and everything else
+     8 bytes at a time, the bytes left over at the end go one by one.
+     All loads are unaligned, so tables inside a bloom_filter_bank
+     buffer work as well as whole bloom_filter tables. bit_count() of
+     two tables counts the bits of their intersection, union or
+     difference without writing it anywhere, which is all an estimate
+     of the cardinality or of the Jaccard similarity needs.
+   */
+
+public:
+
+   enum operation
+   {
+      intersection_operation,
+      union_operation,
+      difference_operation
+   };
+
+   static inline void apply(const operation op, unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      switch (op)
+      {
+         case intersection_operation : apply<intersection_op>(table, other, bytes); break;
+         case union_operation        : apply<union_op>       (table, other, bytes); break;
+         case difference_operation   : apply<difference_op>  (table, other, bytes); break;
+      }
+   }
+
+   static inline bool equal(const unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      // memcmp is already vectorized by every libc worth using
+      return (0 == bytes) || (0 == std::memcmp(table, other, bytes));
+   }
+
+   static inline unsigned long long int bit_count(const unsigned char* table, const std::size_t bytes)
+   {
+      return bit_count<left_op>(table, table, bytes);
+   }
+
+   static inline unsigned long long int bit_count(const operation op, const unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      switch (op)
+      {
+         case intersection_operation : return bit_count<intersection_op>(table, other, bytes);
+         case union_operation        : return bit_count<union_op>       (table, other, bytes);
+         case difference_operation   : return bit_count<difference_op>  (table, other, bytes);
+      }
+
+      return 0;
+   }
+
+   static inline double approximate_element_count(const unsigned long long int bits_set, const unsigned long long int table_size, const std::size_t hash_count)
+   {
+      /*
+        Note:
+        Swamidass and Baldi: n = -(m / k) ln(1 - X / m) for X of the m
+        bits set by k hash functions. A full table is counted as one bit
+        short of full, as it could hold any number of elements. The
+        estimate assumes the bits of a key are independent, which holds
+        for double_hashing_mix64, salted_ap_hash overestimates runs of
+        similar keys.
+      */
+      if ((0 == table_size) || (0 == hash_count))
+         return 0.0;
+
+      const double m = static_cast<double>(table_size);
+      const double x = static_cast<double>(std::min(bits_set, table_size - 1));
+
+      return -(m / hash_count) * std::log(1.0 - x / m);
+   }
+
+   static inline double jaccard(const unsigned char* table, const unsigned char* other, const unsigned long long int table_size, const std::size_t hash_count)
+   {
+      /*
+        Note:
+        |A n B| / |A u B| from the estimated sizes of A, B and their
+        union, |A n B| being |A| + |B| - |A u B|. Two empty filters are
+        identical, so their similarity is 1.
+      */
+      const std::size_t bytes = static_cast<std::size_t>(table_size / bits_per_char);
+
+      const double union_count = approximate_element_count(bit_count(union_operation, table, other, bytes), table_size, hash_count);
+
+      if (union_count <= 0.0)
+         return 1.0;
+
+      const double intersection_count = approximate_element_count(bit_count(table, bytes), table_size, hash_count) +
+                                        approximate_element_count(bit_count(other, bytes), table_size, hash_count) - union_count;
+
+      return std::max(0.0, std::min(1.0, intersection_count / union_count));
+   }
+
+protected:
+
+   struct left_op
+   {
+      static inline unsigned long long int word(const unsigned long long int a, const unsigned long long int) { return a; }
+
+      #if BLOOM_FILTER_X86_BATCH
+      __attribute__((target("avx2")))    static inline __m256i avx2  (const __m256i a, const __m256i) { return a; }
+      __attribute__((target("avx512f"))) static inline __m512i avx512(const __m512i a, const __m512i) { return a; }
+      #endif
+   };
+
+   struct intersection_op
+   {
+      static inline unsigned long long int word(const unsigned long long int a, const unsigned long long int b) { return a & b; }
+
+      #if BLOOM_FILTER_X86_BATCH
+      __attribute__((target("avx2")))    static inline __m256i avx2  (const __m256i a, const __m256i b) { return _mm256_and_si256(a, b); }
+      __attribute__((target("avx512f"))) static inline __m512i avx512(const __m512i a, const __m512i b) { return _mm512_and_si512(a, b); }
+      #endif
+   };
+
+   struct union_op
+   {
+      static inline unsigned long long int word(const unsigned long long int a, const unsigned long long int b) { return a | b; }
+
+      #if BLOOM_FILTER_X86_BATCH
+      __attribute__((target("avx2")))    static inline __m256i avx2  (const __m256i a, const __m256i b) { return _mm256_or_si256(a, b); }
+      __attribute__((target("avx512f"))) static inline __m512i avx512(const __m512i a, const __m512i b) { return _mm512_or_si512(a, b); }
+      #endif
+   };
+
+   struct difference_op
+   {
+      static inline unsigned long long int word(const unsigned long long int a, const unsigned long long int b) { return a ^ b; }
+
+      #if BLOOM_FILTER_X86_BATCH
+      __attribute__((target("avx2")))    static inline __m256i avx2  (const __m256i a, const __m256i b) { return _mm256_xor_si256(a, b); }
+      __attribute__((target("avx512f"))) static inline __m512i avx512(const __m512i a, const __m512i b) { return _mm512_xor_si512(a, b); }
+      #endif
+   };
+
+   template <typename Op>
+   static inline void apply(unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      std::size_t done = 0;
+
+      #if BLOOM_FILTER_X86_BATCH
+      if (__builtin_cpu_supports("avx512f"))
+         done = apply_avx512<Op>(table, other, bytes);
+      else if (__builtin_cpu_supports("avx2"))
+         done = apply_avx2<Op>(table, other, bytes);
+      #endif
+
+      for (; done + sizeof(unsigned long long int) <= bytes; done += sizeof(unsigned long long int))
+      {
+         unsigned long long int a;
+         unsigned long long int b;
+
+         std::memcpy(&a, table + done, sizeof(a));
+         std::memcpy(&b, other + done, sizeof(b));
+
+         a = Op::word(a, b);
+
+         std::memcpy(table + done, &a, sizeof(a));
+      }
+
+      for (; done < bytes; ++done)
+      {
+         table[done] = static_cast<unsigned char>(Op::word(table[done], other[done]));
+      }
+   }
+
+   template <typename Op>
+   static inline unsigned long long int bit_count(const unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      std::size_t done = 0;
+      unsigned long long int count = 0;
+
+      #if BLOOM_FILTER_X86_BATCH
+      if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+         done = bit_count_avx512<Op>(table, other, bytes, count);
+      else if (__builtin_cpu_supports("avx2"))
+         done = bit_count_avx2<Op>(table, other, bytes, count);
+
+      if (__builtin_cpu_supports("popcnt"))
+         done = bit_count_popcnt<Op>(table, other, bytes, done, count);
+      #endif
+
+      for (; done + sizeof(unsigned long long int) <= bytes; done += sizeof(unsigned long long int))
+      {
+         unsigned long long int a;
+         unsigned long long int b;
+
+         std::memcpy(&a, table + done, sizeof(a));
+         std::memcpy(&b, other + done, sizeof(b));
+
+         count += __builtin_popcountll(Op::word(a, b));
+      }
+
+      for (; done < bytes; ++done)
+      {
+         count += __builtin_popcountll(Op::word(table[done], other[done]) & 0xFF);
+      }
+
+      return count;
+   }
+
+   #if BLOOM_FILTER_X86_BATCH
+   template <typename Op>
+   __attribute__((target("avx2")))
+   static std::size_t apply_avx2(unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      std::size_t k = 0;
+
+      for (; k + sizeof(__m256i) <= bytes; k += sizeof(__m256i))
+      {
+         const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table + k));
+         const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + k));
+
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(table + k), Op::avx2(a, b));
+      }
+
+      return k;
+   }
+
+   template <typename Op>
+   __attribute__((target("avx512f")))
+   static std::size_t apply_avx512(unsigned char* table, const unsigned char* other, const std::size_t bytes)
+   {
+      std::size_t k = 0;
+
+      for (; k + sizeof(__m512i) <= bytes; k += sizeof(__m512i))
+      {
+         const __m512i a = _mm512_loadu_si512(table + k);
+         const __m512i b = _mm512_loadu_si512(other + k);
+
+         _mm512_storeu_si512(table + k, Op::avx512(a, b));
+      }
+
+      return k;
+   }
+
+   template <typename Op>
+   __attribute__((target("popcnt")))
+   static std::size_t bit_count_popcnt(const unsigned char* table, const unsigned char* other, const std::size_t bytes, std::size_t k, unsigned long long int& count)
+   {
+      for (; k + sizeof(unsigned long long int) <= bytes; k += sizeof(unsigned long long int))
+      {
+         unsigned long long int a;
+         unsigned long long int b;
+
+         std::memcpy(&a, table + k, sizeof(a));
+         std::memcpy(&b, other + k, sizeof(b));
+
+         count += __builtin_popcountll(Op::word(a, b));
+      }
+
+      return k;
+   }
+
+   template <typename Op>
+   __attribute__((target("avx2")))
+   static std::size_t bit_count_avx2(const unsigned char* table, const unsigned char* other, const std::size_t bytes, unsigned long long int& count)
+   {
+      // Mula: the bits of every nibble are looked up with a byte shuffle and the bytes summed with sad
+      const __m256i lookup   = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+      const __m256i low_mask = _mm256_set1_epi8(0x0F);
+
+      __m256i total = _mm256_setzero_si256();
+
+      std::size_t k = 0;
+
+      for (; k + sizeof(__m256i) <= bytes; k += sizeof(__m256i))
+      {
+         const __m256i v = Op::avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(table + k)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + k)));
+
+         const __m256i bits = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask)),
+                                              _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask)));
+
+         total = _mm256_add_epi64(total, _mm256_sad_epu8(bits, _mm256_setzero_si256()));
+      }
+
+      count += static_cast<unsigned long long int>(_mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                                                   _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3));
+
+      return k;
    }
 
+   template <typename Op>
+   __attribute__((target("avx512f,avx512vpopcntdq")))
+   static std::size_t bit_count_avx512(const unsigned char* table, const unsigned char* other, const std::size_t bytes, unsigned long long int& count)
+   {
+      __m512i total = _mm512_setzero_si512();
+
+      std::size_t k = 0;
+
+      for (; k + sizeof(__m512i) <= bytes; k += sizeof(__m512i))
+      {
+         total = _mm512_add_epi64(total, _mm512_popcnt_epi64(Op::avx512(_mm512_loadu_si512(table + k), _mm512_loadu_si512(other + k))));
+      }
+
+      unsigned long long int lanes[sizeof(__m512i) / sizeof(unsigned long long int)];
+
+      _mm512_storeu_si512(lanes, total);
+
+      for (std::size_t i = 0; i < sizeof(lanes) / sizeof(lanes[0]); ++i)
+      {
+         count += lanes[i];
+      }
+
+      return k;
+   }
+   #endif
 };
 
 class bloom_filter
 {
+   friend class blocked_bloom_filter;
+   friend class counting_bloom_filter;
+   friend class bloom_filter_bank;
+   friend class bloom_batch_query;
+
 protected:
 
    typedef unsigned int bloom_type;
    typedef unsigned char cell_type;
-   typedef std::vector<unsigned char> table_type;
+   typedef std::vector<unsigned char, bloom_aligned_allocator<unsigned char> > table_type;
 
 public:
 
@@ -177,14 +687,18 @@ public:
      projected_element_count_(0),
      inserted_element_count_ (0),
      random_seed_(0),
-     desired_false_positive_probability_(0.0)
+     desired_false_positive_probability_(0.0),
+     hash_scheme_(salted_ap_hash),
+     index_scheme_(modulo_index)
    {}
 
    bloom_filter(const bloom_parameters& p)
    : projected_element_count_(p.projected_element_count),
      inserted_element_count_(0),
      random_seed_((p.random_seed * 0xA5A5A5A5) + 1),
-     desired_false_positive_probability_(p.false_positive_probability)
+     desired_false_positive_probability_(p.false_positive_probability),
+     hash_scheme_(p.hash_scheme),
+     index_scheme_(p.index_scheme)
    {
       salt_count_ = p.optimal_parameters.number_of_hashes;
       table_size_ = p.optimal_parameters.table_size;
@@ -211,8 +725,10 @@ public:
             (inserted_element_count_             == f.inserted_element_count_            ) &&
             (random_seed_                        == f.random_seed_                       ) &&
             (desired_false_positive_probability_ == f.desired_false_positive_probability_) &&
+            (hash_scheme_                        == f.hash_scheme_                       ) &&
+            (index_scheme_                       == f.index_scheme_                      ) &&
             (salt_                               == f.salt_                              ) &&
-            (bit_table_                          == f.bit_table_                         ) ;
+            bloom_table_algebra::equal(bit_table_.data(), f.bit_table_.data(), bit_table_.size());
       }
       else
          return true;
@@ -238,6 +754,9 @@ public:
          random_seed_ = f.random_seed_;
 
          desired_false_positive_probability_ = f.desired_false_positive_probability_;
+
+         hash_scheme_  = f.hash_scheme_;
+         index_scheme_ = f.index_scheme_;
       }
 
       return *this;
@@ -262,9 +781,12 @@ public:
       std::size_t bit_index = 0;
       std::size_t bit       = 0;
 
+      const unsigned long long int base = base_hash(key_begin, length);
+      probe_sequence probes(base, table_size_, index_scheme_);
+
       for (std::size_t i = 0; i < salt_.size(); ++i)
       {
-         compute_indices(hash_ap(key_begin, length, salt_[i]), bit_index, bit);
+         compute_indices(table_index(key_begin, length, probes, i), bit_index, bit);
 
          bit_table_[bit_index / bits_per_char] |= bit_mask[bit];
       }
@@ -305,9 +827,12 @@ public:
       std::size_t bit_index = 0;
       std::size_t bit       = 0;
 
+      const unsigned long long int base = base_hash(key_begin, length);
+      probe_sequence probes(base, table_size_, index_scheme_);
+
       for (std::size_t i = 0; i < salt_.size(); ++i)
       {
-         compute_indices(hash_ap(key_begin, length, salt_[i]), bit_index, bit);
+         compute_indices(table_index(key_begin, length, probes, i), bit_index, bit);
 
          if ((bit_table_[bit_index / bits_per_char] & bit_mask[bit]) != bit_mask[bit])
          {
@@ -398,13 +923,12 @@ public:
       if (
            (salt_count_  == f.salt_count_ ) &&
            (table_size_  == f.table_size_ ) &&
-           (random_seed_ == f.random_seed_)
+           (random_seed_ == f.random_seed_) &&
+           (hash_scheme_ == f.hash_scheme_) &&
+           (index_scheme_ == f.index_scheme_)
          )
       {
-         for (std::size_t i = 0; i < bit_table_.size(); ++i)
-         {
-            bit_table_[i] &= f.bit_table_[i];
-         }
+         bloom_table_algebra::apply(bloom_table_algebra::intersection_operation, bit_table_.data(), f.bit_table_.data(), bit_table_.size());
       }
 
       return *this;
@@ -416,13 +940,12 @@ public:
       if (
            (salt_count_  == f.salt_count_ ) &&
            (table_size_  == f.table_size_ ) &&
-           (random_seed_ == f.random_seed_)
+           (random_seed_ == f.random_seed_) &&
+           (hash_scheme_ == f.hash_scheme_) &&
+           (index_scheme_ == f.index_scheme_)
          )
       {
-         for (std::size_t i = 0; i < bit_table_.size(); ++i)
-         {
-            bit_table_[i] |= f.bit_table_[i];
-         }
+         bloom_table_algebra::apply(bloom_table_algebra::union_operation, bit_table_.data(), f.bit_table_.data(), bit_table_.size());
       }
 
       return *this;
@@ -434,50 +957,99 @@ public:
       if (
            (salt_count_  == f.salt_count_ ) &&
            (table_size_  == f.table_size_ ) &&
-           (random_seed_ == f.random_seed_)
+           (random_seed_ == f.random_seed_) &&
+           (hash_scheme_ == f.hash_scheme_) &&
+           (index_scheme_ == f.index_scheme_)
          )
       {
-         for (std::size_t i = 0; i < bit_table_.size(); ++i)
-         {
-            bit_table_[i] ^= f.bit_table_[i];
-         }
+         bloom_table_algebra::apply(bloom_table_algebra::difference_operation, bit_table_.data(), f.bit_table_.data(), bit_table_.size());
       }
 
       return *this;
    }
 
-   inline const cell_type* table() const
+   inline bool compatible(const bloom_filter& f) const
    {
-      return bit_table_.data();
+      /* same bits for the same keys, so that the set algebra is meaningful */
+      return
+         (salt_count_   == f.salt_count_  ) &&
+         (table_size_   == f.table_size_  ) &&
+         (random_seed_  == f.random_seed_ ) &&
+         (hash_scheme_  == f.hash_scheme_ ) &&
+         (index_scheme_ == f.index_scheme_) ;
    }
 
-   inline std::size_t hash_count()
+   inline unsigned long long int bit_count() const
    {
-      return salt_.size();
+      return bloom_table_algebra::bit_count(bit_table_.data(), bit_table_.size());
    }
 
-protected:
-
-   inline virtual void compute_indices(const bloom_type& hash, std::size_t& bit_index, std::size_t& bit) const
+   inline double approximate_element_count() const
    {
-      bit_index = hash % table_size_;
-      bit       = bit_index % bits_per_char;
+      /*
+        Note:
+        Estimated from the bits that are set rather than taken from
+        element_count(), so it is also meaningful after &=, |= or ^=
+        and for keys that were inserted more than once.
+      */
+      return bloom_table_algebra::approximate_element_count(bit_count(), table_size_, salt_.size());
    }
 
-   void generate_unique_salt()
+   inline double jaccard(const bloom_filter& f) const
    {
       /*
         Note:
-        A distinct hash function need not be implementation-wise
-        distinct. In the current implementation "seeding" a common
-        hash function with different values seems to be adequate.
+        Estimated Jaccard similarity of the two sets, 0 if the filters
+        are not compatible().
       */
-      const unsigned int predef_salt_count = 128;
+      if (!compatible(f))
+         return 0.0;
 
-      static const bloom_type predef_salt[predef_salt_count] =
-                                 {
-                                    0xAAAAAAAA, 0x55555555, 0x33333333, 0xCCCCCCCC,
-                                    0x66666666, 0x99999999, 0xB5B5B5B5, 0x4B4B4B4B,
+      return bloom_table_algebra::jaccard(bit_table_.data(), f.bit_table_.data(), table_size_, salt_.size());
+   }
+
+   inline const cell_type* table() const
+   {
+      return bit_table_.data();
+   }
+
+   inline std::size_t hash_count() const
+   {
+      return salt_.size();
+   }
+
+protected:
+
+   inline virtual void compute_indices(const std::size_t index, std::size_t& bit_index, std::size_t& bit) const
+   {
+      bit_index = index;
+      bit       = bit_index % bits_per_char;
+   }
+
+   static inline std::size_t reduce(const bloom_type hash, const unsigned long long int table_size, const bloom_index_scheme scheme)
+   {
+      switch (scheme)
+      {
+         case power_of_two_index : return static_cast<std::size_t>(hash & (table_size - 1));
+         case fastrange_index    : return static_cast<std::size_t>((static_cast<unsigned long long int>(hash) * table_size) >> 32);
+         default                 : return static_cast<std::size_t>(hash % table_size);
+      }
+   }
+
+   void generate_unique_salt()
+   {
+      /*
+        Note:
+        A distinct hash function need not be implementation-wise
+        distinct. In the current implementation "seeding" a common
+        hash function with different values seems to be adequate.
+      */
+      const unsigned int predef_salt_count = 128;
+
+      static const bloom_type predef_salt[predef_salt_count] =
+                                 {
+                                    0xAAAAAAAA, 0x55555555, 0x33333333, 0xCCCCCCCC,
+                                    0x66666666, 0x99999999, 0xB5B5B5B5, 0x4B4B4B4B,
                                     0xAA55AA55, 0x55335533, 0x33CC33CC, 0xCC66CC66,
                                     0x66996699, 0x99B599B5, 0xB54BB54B, 0x4BAA4BAA,
                                     0xAA33AA33, 0x55CC55CC, 0x33663366, 0xCC99CC99,
@@ -548,7 +1120,125 @@ protected:
       }
    }
 
-   inline bloom_type hash_ap(const unsigned char* begin, std::size_t remaining_length, bloom_type hash) const
+   inline unsigned long long int base_hash(const unsigned char* key_begin, const std::size_t length) const
+   {
+      return (double_hashing_mix64 == hash_scheme_) ? hash_mix64(key_begin, length, random_seed_) : 0;
+   }
+
+   static inline bloom_type double_hash(const unsigned long long int base, const std::size_t i)
+   {
+      // h2 is odd so that the probes cycle through every residue of a power of two table
+      return static_cast<bloom_type>(base) + static_cast<bloom_type>(i) * (static_cast<bloom_type>(base >> 32) | 0x01);
+   }
+
+   class probe_sequence
+   {
+   public:
+
+      /*
+        Note:
+        The table indices of the double hashing probes of one key, in
+        order. fastrange_index steps through the table itself instead
+        of reducing every probe, see the note of bloom_index_scheme.
+        The step grows by i after the i-th probe (enhanced double
+        hashing), a fixed step would give two keys whose first index
+        differs by the step all but one of their bits.
+      */
+      probe_sequence(const unsigned long long int base, const unsigned long long int table_size, const bloom_index_scheme scheme)
+      : base_(base),
+        table_size_(table_size),
+        scheme_(scheme),
+        i_(0),
+        index_(0),
+        step_(0)
+      {
+         if (fastrange_index == scheme_)
+         {
+            index_ = reduce(static_cast<bloom_type>(base), table_size, fastrange_index);
+            step_  = reduce(static_cast<bloom_type>(base >> 32), table_size - 1, fastrange_index) | 0x01;
+         }
+      }
+
+      inline std::size_t next()
+      {
+         if (fastrange_index != scheme_)
+            return reduce(double_hash(base_, i_++), table_size_, scheme_);
+
+         const std::size_t index = index_;
+
+         index_ += step_;
+
+         if (index_ >= table_size_)
+            index_ -= table_size_;
+
+         step_ += ++i_;
+
+         while (step_ >= table_size_)
+            step_ -= table_size_;
+
+         return index;
+      }
+
+   private:
+
+      unsigned long long int base_;
+      unsigned long long int table_size_;
+      bloom_index_scheme     scheme_;
+      std::size_t            i_;
+      std::size_t            index_;
+      std::size_t            step_;
+   };
+
+   inline std::size_t table_index(const unsigned char* key_begin, const std::size_t length,
+                                  probe_sequence& probes, const std::size_t i) const
+   {
+      if (double_hashing_mix64 == hash_scheme_)
+         return probes.next();
+      else
+         return reduce(hash_ap(key_begin, length, salt_[i]), table_size_, index_scheme_);
+   }
+
+   static inline unsigned long long int hash_mix64(const unsigned char* begin, std::size_t remaining_length, const unsigned long long int seed)
+   {
+      /*
+        Note:
+        Keys are folded in 8 byte words, so the 4 byte integer keys this
+        filter is mostly used with take a single multiply before the
+        murmur3 64 bit finalizer.
+      */
+      const unsigned long long int multiplier = 0x9E3779B97F4A7C15ULL;
+
+      unsigned long long int hash = seed ^ (remaining_length * multiplier);
+
+      while (remaining_length >= 8)
+      {
+         unsigned long long int word = 0;
+         std::memcpy(&word, begin, 8);
+
+         hash = (hash ^ word) * multiplier;
+
+         begin            += 8;
+         remaining_length -= 8;
+      }
+
+      if (remaining_length)
+      {
+         unsigned long long int word = 0;
+         std::memcpy(&word, begin, remaining_length);
+
+         hash = (hash ^ word) * multiplier;
+      }
+
+      hash ^= hash >> 33;
+      hash *= 0xFF51AFD7ED558CCDULL;
+      hash ^= hash >> 33;
+      hash *= 0xC4CEB9FE1A85EC53ULL;
+      hash ^= hash >> 33;
+
+      return hash;
+   }
+
+   static inline bloom_type hash_ap(const unsigned char* begin, std::size_t remaining_length, bloom_type hash)
    {
       const unsigned char* itr = begin;
       unsigned int loop        = 0;
@@ -608,13 +1298,15 @@ protected:
    }
 
    std::vector<bloom_type>    salt_;
-   std::vector<unsigned char> bit_table_;
+   table_type                 bit_table_;
    unsigned int               salt_count_;
    unsigned long long int     table_size_;
    unsigned long long int     projected_element_count_;
    unsigned long long int     inserted_element_count_;
    unsigned long long int     random_seed_;
    double                     desired_false_positive_probability_;
+   bloom_hash_scheme          hash_scheme_;
+   bloom_index_scheme         index_scheme_;
 };
 
 inline bloom_filter operator & (const bloom_filter& a, const bloom_filter& b)
@@ -704,13 +1396,24 @@ public:
 
 private:
 
-   inline void compute_indices(const bloom_type& hash, std::size_t& bit_index, std::size_t& bit) const
+   inline void compute_indices(const std::size_t index, std::size_t& bit_index, std::size_t& bit) const
    {
-      bit_index = hash;
+      /*
+        Note:
+        The index is an index of the original table, reduced with the
+        index scheme of the filter. Every compression folded the upper part of the
+        table onto its lower part, so instead of taking the modulo of
+        every compressed size the folds are undone by subtraction, which
+        gives the same index without any division.
+      */
+      bit_index = index;
 
-      for (std::size_t i = 0; i < size_list.size(); ++i)
+      for (std::size_t i = 1; i < size_list.size(); ++i)
       {
-         bit_index %= size_list[i];
+         while (bit_index >= size_list[i])
+         {
+            bit_index -= static_cast<std::size_t>(size_list[i]);
+         }
       }
 
       bit = bit_index % bits_per_char;
@@ -719,6 +1422,1378 @@ private:
    std::vector<unsigned long long int> size_list;
 };
 
+struct alignas(64) bloom_cache_line
+{
+   unsigned char bytes[64];
+};
+
+class blocked_bloom_filter
+{
+   /*
+     Note:
+     Cache line blocked bloom filter. The table is split into 64 byte
+     blocks. The key is mixed into one 64 bit hash, its upper half
+     selects a block and all the k bits of the key are derived inside
+     that block by double hashing its lower half, so a query touches
+     exactly one cache line no matter how many hash functions are used. The price is a slightly higher
+     false positive probability than a standard bloom filter of the
+     same size, as the load of the blocks is not perfectly uniform.
+   */
+
+protected:
+
+   typedef bloom_filter::bloom_type bloom_type;
+   typedef std::vector<bloom_cache_line> table_type;
+
+public:
+
+   static const std::size_t block_size     = sizeof(bloom_cache_line);
+   static const std::size_t bits_per_block = block_size * bits_per_char;
+
+   blocked_bloom_filter()
+   : hash_count_(0),
+     block_count_(0),
+     projected_element_count_(0),
+     inserted_element_count_(0),
+     random_seed_(0)
+   {}
+
+   blocked_bloom_filter(const bloom_parameters& p)
+   : hash_count_(p.optimal_parameters.number_of_hashes),
+     projected_element_count_(p.projected_element_count),
+     inserted_element_count_(0),
+     random_seed_((p.random_seed * 0xA5A5A5A5) + 1)
+   {
+      block_count_ = block_count_for(p.optimal_parameters.table_size);
+
+      bit_table_.resize(static_cast<std::size_t>(block_count_), bloom_cache_line());
+   }
+
+   inline bool operator!() const
+   {
+      return (0 == block_count_);
+   }
+
+   inline void clear()
+   {
+      std::fill(mutable_table(), mutable_table() + block_count_ * block_size, static_cast<unsigned char>(0x00));
+      inserted_element_count_ = 0;
+   }
+
+   inline void insert(const unsigned char* key_begin, const std::size_t& length)
+   {
+      insert_into_block(mutable_table(), block_count_, hash_count_, random_seed_, key_begin, length);
+
+      ++inserted_element_count_;
+   }
+
+   template <typename T>
+   inline void insert(const T& t)
+   {
+      // Note: T must be a C++ POD type.
+      insert(reinterpret_cast<const unsigned char*>(&t),sizeof(T));
+   }
+
+   inline void insert(const std::string& key)
+   {
+      insert(reinterpret_cast<const unsigned char*>(key.data()),key.size());
+   }
+
+   inline void insert(const char* data, const std::size_t& length)
+   {
+      insert(reinterpret_cast<const unsigned char*>(data),length);
+   }
+
+   inline bool contains(const unsigned char* key_begin, const std::size_t length) const
+   {
+      return block_contains(table(), block_count_, hash_count_, random_seed_, key_begin, length);
+   }
+
+   template <typename T>
+   inline bool contains(const T& t) const
+   {
+      return contains(reinterpret_cast<const unsigned char*>(&t),static_cast<std::size_t>(sizeof(T)));
+   }
+
+   inline bool contains(const std::string& key) const
+   {
+      return contains(reinterpret_cast<const unsigned char*>(key.c_str()),key.size());
+   }
+
+   inline bool contains(const char* data, const std::size_t& length) const
+   {
+      return contains(reinterpret_cast<const unsigned char*>(data),length);
+   }
+
+   inline unsigned long long int size() const
+   {
+      return block_count_ * bits_per_block;
+   }
+
+   inline unsigned long long int element_count() const
+   {
+      return inserted_element_count_;
+   }
+
+   inline double effective_fpp() const
+   {
+      /*
+        Note:
+        Same estimate as bloom_filter::effective_fpp, it does not account
+        for the uneven load of the blocks and therefore slightly under
+        estimates the false positive probability of a blocked filter.
+      */
+      return std::pow(1.0 - std::exp(-1.0 * hash_count_ * inserted_element_count_ / size()), 1.0 * hash_count_);
+   }
+
+   inline std::size_t hash_count() const
+   {
+      return hash_count_;
+   }
+
+   inline const unsigned char* table() const
+   {
+      return reinterpret_cast<const unsigned char*>(bit_table_.data());
+   }
+
+   static inline unsigned long long int block_count_for(const unsigned long long int table_size)
+   {
+      const unsigned long long int blocks = (table_size + bits_per_block - 1) / bits_per_block;
+
+      return (0 == blocks) ? 1 : blocks;
+   }
+
+   static inline std::size_t bit_in_block(const unsigned long long int hash, const std::size_t i)
+   {
+      // the lower half of the hash is split into the two 16 bit halves h1 and h2
+      const bloom_type h1 = static_cast<bloom_type>(hash) & 0xFFFF;
+      const bloom_type h2 = ((static_cast<bloom_type>(hash) >> 16) & 0xFFFF) | 0x01;
+
+      return (h1 + static_cast<bloom_type>(i) * h2) & (bits_per_block - 1);
+   }
+
+   static inline void insert_into_block(unsigned char* table, const unsigned long long int block_count, const std::size_t hash_count,
+                                        const unsigned long long int seed,
+                                        const unsigned char* key_begin, const std::size_t length)
+   {
+      const unsigned long long int hash = bloom_filter::hash_mix64(key_begin, length, seed);
+
+      unsigned char* block = table + (((hash >> 32) * block_count) >> 32) * block_size;
+
+      for (std::size_t i = 0; i < hash_count; ++i)
+      {
+         const std::size_t bit_index = bit_in_block(hash, i);
+
+         block[bit_index / bits_per_char] |= bit_mask[bit_index % bits_per_char];
+      }
+   }
+
+   static inline bool block_contains(const unsigned char* table, const unsigned long long int block_count, const std::size_t hash_count,
+                                     const unsigned long long int seed,
+                                     const unsigned char* key_begin, const std::size_t length)
+   {
+      const unsigned long long int hash = bloom_filter::hash_mix64(key_begin, length, seed);
+
+      const unsigned char* block = table + (((hash >> 32) * block_count) >> 32) * block_size;
+
+      for (std::size_t i = 0; i < hash_count; ++i)
+      {
+         const std::size_t bit_index = bit_in_block(hash, i);
+
+         if ((block[bit_index / bits_per_char] & bit_mask[bit_index % bits_per_char]) == 0)
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+protected:
+
+   inline unsigned char* mutable_table()
+   {
+      return reinterpret_cast<unsigned char*>(bit_table_.data());
+   }
+
+   table_type             bit_table_;
+   std::size_t            hash_count_;
+   unsigned long long int block_count_;
+   unsigned long long int projected_element_count_;
+   unsigned long long int inserted_element_count_;
+   unsigned long long int random_seed_;
+};
+
+class counting_bloom_filter
+{
+   /*
+     Note:
+     Counting bloom filter with 4 bit counters packed two to a byte, so
+     it is four times the size of a bloom_filter with the same number
+     of cells but supports erase(). A key is always hashed with
+     double_hashing_mix64, the index scheme of the parameters is used
+     to reduce the hashes to counters. A counter that reaches 15 is
+     saturated: it is never decremented again because the number of
+     keys it counts is no longer known, so erasing can never introduce
+     a false negative, it merely leaves such a counter set forever.
+     Only keys that were inserted may be erased, erasing a key that was
+     never inserted but happens to be a false positive corrupts the
+     counters of other keys.
+   */
+
+public:
+
+   static const unsigned char max_count = 0x0F;
+
+   counting_bloom_filter()
+   : counter_count_(0),
+     hash_count_(0),
+     projected_element_count_(0),
+     inserted_element_count_(0),
+     saturated_count_(0),
+     random_seed_(0),
+     index_scheme_(modulo_index)
+   {}
+
+   counting_bloom_filter(const bloom_parameters& p)
+   : counter_count_(p.optimal_parameters.table_size),
+     hash_count_(p.optimal_parameters.number_of_hashes),
+     projected_element_count_(p.projected_element_count),
+     inserted_element_count_(0),
+     saturated_count_(0),
+     random_seed_((p.random_seed * 0xA5A5A5A5) + 1),
+     index_scheme_(p.index_scheme)
+   {
+      counter_table_.resize(static_cast<std::size_t>(table_bytes_for(counter_count_)), static_cast<unsigned char>(0x00));
+   }
+
+   inline bool operator!() const
+   {
+      return (0 == counter_count_);
+   }
+
+   inline void clear()
+   {
+      std::fill(counter_table_.begin(), counter_table_.end(), static_cast<unsigned char>(0x00));
+      inserted_element_count_ = 0;
+      saturated_count_        = 0;
+   }
+
+   inline void insert(const unsigned char* key_begin, const std::size_t& length)
+   {
+      saturated_count_ += increment_counters(counter_table_.data(), counter_count_, hash_count_, random_seed_, index_scheme_, key_begin, length);
+
+      ++inserted_element_count_;
+   }
+
+   template <typename T>
+   inline void insert(const T& t)
+   {
+      // Note: T must be a C++ POD type.
+      insert(reinterpret_cast<const unsigned char*>(&t),sizeof(T));
+   }
+
+   inline bool erase(const unsigned char* key_begin, const std::size_t& length)
+   {
+      // Note: Returns false and changes nothing if the key is definitely not in the filter.
+      if (!decrement_counters(counter_table_.data(), counter_count_, hash_count_, random_seed_, index_scheme_, key_begin, length))
+         return false;
+
+      if (inserted_element_count_ > 0)
+         --inserted_element_count_;
+
+      return true;
+   }
+
+   template <typename T>
+   inline bool erase(const T& t)
+   {
+      return erase(reinterpret_cast<const unsigned char*>(&t),sizeof(T));
+   }
+
+   inline bool contains(const unsigned char* key_begin, const std::size_t length) const
+   {
+      return counters_contain(counter_table_.data(), counter_count_, hash_count_, random_seed_, index_scheme_, key_begin, length);
+   }
+
+   template <typename T>
+   inline bool contains(const T& t) const
+   {
+      return contains(reinterpret_cast<const unsigned char*>(&t),static_cast<std::size_t>(sizeof(T)));
+   }
+
+   inline unsigned long long int size() const
+   {
+      return counter_count_;
+   }
+
+   inline unsigned long long int element_count() const
+   {
+      return inserted_element_count_;
+   }
+
+   inline unsigned long long int saturated_count() const
+   {
+      // number of counters that saturated since the last clear()
+      return saturated_count_;
+   }
+
+   inline double effective_fpp() const
+   {
+      return std::pow(1.0 - std::exp(-1.0 * hash_count_ * inserted_element_count_ / size()), 1.0 * hash_count_);
+   }
+
+   inline std::size_t hash_count() const
+   {
+      return hash_count_;
+   }
+
+   static inline unsigned long long int table_bytes_for(const unsigned long long int counter_count)
+   {
+      return (counter_count + 1) / 2;
+   }
+
+   static inline unsigned char counter(const unsigned char* table, const std::size_t index)
+   {
+      return (table[index / 2] >> ((index & 1) * 4)) & max_count;
+   }
+
+   static inline std::size_t increment_counters(unsigned char* table, const unsigned long long int counter_count, const std::size_t hash_count,
+                                                const unsigned long long int seed, const bloom_index_scheme index_scheme,
+                                                const unsigned char* key_begin, const std::size_t length)
+   {
+      // returns the number of counters that saturated
+      bloom_filter::probe_sequence probes(bloom_filter::hash_mix64(key_begin, length, seed), counter_count, index_scheme);
+      std::size_t saturated = 0;
+
+      for (std::size_t i = 0; i < hash_count; ++i)
+      {
+         const std::size_t index = probes.next();
+
+         if (max_count == counter(table, index))
+            continue;
+
+         table[index / 2] += static_cast<unsigned char>(1 << ((index & 1) * 4));
+
+         if (max_count == counter(table, index))
+            ++saturated;
+      }
+
+      return saturated;
+   }
+
+   static inline bool decrement_counters(unsigned char* table, const unsigned long long int counter_count, const std::size_t hash_count,
+                                         const unsigned long long int seed, const bloom_index_scheme index_scheme,
+                                         const unsigned char* key_begin, const std::size_t length)
+   {
+      if (!counters_contain(table, counter_count, hash_count, seed, index_scheme, key_begin, length))
+         return false;
+
+      bloom_filter::probe_sequence probes(bloom_filter::hash_mix64(key_begin, length, seed), counter_count, index_scheme);
+
+      for (std::size_t i = 0; i < hash_count; ++i)
+      {
+         const std::size_t index = probes.next();
+
+         if (max_count != counter(table, index))
+            table[index / 2] -= static_cast<unsigned char>(1 << ((index & 1) * 4));
+      }
+
+      return true;
+   }
+
+   static inline bool counters_contain(const unsigned char* table, const unsigned long long int counter_count, const std::size_t hash_count,
+                                       const unsigned long long int seed, const bloom_index_scheme index_scheme,
+                                       const unsigned char* key_begin, const std::size_t length)
+   {
+      bloom_filter::probe_sequence probes(bloom_filter::hash_mix64(key_begin, length, seed), counter_count, index_scheme);
+
+      for (std::size_t i = 0; i < hash_count; ++i)
+      {
+         if (0 == counter(table, probes.next()))
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+protected:
+
+   std::vector<unsigned char> counter_table_;
+   unsigned long long int     counter_count_;
+   std::size_t                hash_count_;
+   unsigned long long int     projected_element_count_;
+   unsigned long long int     inserted_element_count_;
+   unsigned long long int     saturated_count_;
+   unsigned long long int     random_seed_;
+   bloom_index_scheme         index_scheme_;
+};
+
+class bloom_batch_query
+{
+   /*
+     Note:
+     Answers contains() for a batch of integer keys against a single
+     table hashed with double_hashing_mix64 and reduced with either
+     fastrange_index or power_of_two_index. Bit i of the result bitmap
+     is set when keys[i] may be in the filter. The widest kernel the CPU
+     supports is picked at runtime: AVX-512 hashes and gathers 16 keys
+     per iteration, AVX2 8 keys and everything else, including the keys
+     left over at the end of the batch, goes through the scalar loop.
+     The vector kernels load 4 bytes for every probe, so the table must
+     be followed by at least 3 readable bytes.
+   */
+
+public:
+
+   struct table_view
+   {
+      const unsigned char*   table;
+      unsigned long long int table_size;
+      std::size_t            hash_count;
+      unsigned long long int seed;
+      bloom_index_scheme     index_scheme;
+   };
+
+   static inline void contains(const table_view& view, const int* keys, const std::size_t count, unsigned long long int* result)
+   {
+      std::fill(result, result + (count + 63) / 64, 0ULL);
+
+      std::size_t done = 0;
+
+      #if BLOOM_FILTER_X86_BATCH
+      // the lanes hold 32 bit indices, a fastrange probe plus its step must not wrap around 2^32 and its step only wraps once
+      const bool vectorizable = (modulo_index != view.index_scheme) &&
+                                (view.table_size <= 0x7FFFFFFFULL) &&
+                                (view.hash_count < view.table_size);
+
+      if (vectorizable && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+         done = contains_avx512(view, keys, count, result);
+      else if (vectorizable && __builtin_cpu_supports("avx2"))
+         done = contains_avx2(view, keys, count, result);
+      #endif
+
+      contains_scalar(view, keys, done, count, result);
+   }
+
+   static inline void contains_scalar(const table_view& view, const int* keys, const std::size_t first, const std::size_t count, unsigned long long int* result)
+   {
+      for (std::size_t k = first; k < count; ++k)
+      {
+         bloom_filter::probe_sequence probes(bloom_filter::hash_mix64(reinterpret_cast<const unsigned char*>(keys + k), sizeof(int), view.seed),
+                                             view.table_size, view.index_scheme);
+
+         bool found = true;
+
+         for (std::size_t i = 0; found && (i < view.hash_count); ++i)
+         {
+            const std::size_t bit_index = probes.next();
+
+            found = (view.table[bit_index / bits_per_char] & bit_mask[bit_index % bits_per_char]) != 0;
+         }
+
+         if (found)
+         {
+            result[k / 64] |= 1ULL << (k % 64);
+         }
+      }
+   }
+
+private:
+
+   #if BLOOM_FILTER_X86_BATCH
+   __attribute__((target("avx2")))
+   static inline __m256i mullo64_avx2(const __m256i a, const __m256i b)
+   {
+      // AVX2 has no 64 bit multiply: lo*lo + ((lo*hi + hi*lo) << 32)
+      const __m256i lo_lo = _mm256_mul_epu32(a, b);
+      const __m256i lo_hi = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+      const __m256i hi_lo = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+
+      return _mm256_add_epi64(lo_lo, _mm256_slli_epi64(_mm256_add_epi64(lo_hi, hi_lo), 32));
+   }
+
+   __attribute__((target("avx2")))
+   static inline __m256i mix64_avx2(const __m128i keys, const __m256i seed)
+   {
+      // same as bloom_filter::hash_mix64 of a 4 byte key, for 4 keys
+      const __m256i multiplier = _mm256_set1_epi64x(static_cast<long long>(0x9E3779B97F4A7C15ULL));
+
+      __m256i hash = mullo64_avx2(_mm256_xor_si256(seed, _mm256_cvtepu32_epi64(keys)), multiplier);
+
+      hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 33));
+      hash = mullo64_avx2(hash, _mm256_set1_epi64x(static_cast<long long>(0xFF51AFD7ED558CCDULL)));
+      hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 33));
+      hash = mullo64_avx2(hash, _mm256_set1_epi64x(static_cast<long long>(0xC4CEB9FE1A85EC53ULL)));
+      hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 33));
+
+      return hash;
+   }
+
+   // (x * range) >> 32 of 8 32 bit lanes, range is the same in the lower half of every 64 bit lane
+   __attribute__((target("avx2")))
+   static inline __m256i fastrange_avx2(const __m256i x, const __m256i range)
+   {
+      const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, range), 32);
+      const __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), range);
+
+      return _mm256_blend_epi32(even, odd, 0xAA);
+   }
+
+   __attribute__((target("avx2")))
+   static std::size_t contains_avx2(const table_view& view, const int* keys, const std::size_t count, unsigned long long int* result)
+   {
+      const __m256i seed        = _mm256_set1_epi64x(static_cast<long long>(view.seed ^ (sizeof(int) * 0x9E3779B97F4A7C15ULL)));
+      const __m256i table_size  = _mm256_set1_epi64x(static_cast<long long>(view.table_size));
+      const __m256i step_range  = _mm256_set1_epi64x(static_cast<long long>(view.table_size - 1));
+      const __m256i wrap        = _mm256_set1_epi32(static_cast<int>(view.table_size));
+      const __m256i mask        = _mm256_set1_epi32(static_cast<int>(view.table_size - 1));
+      const __m256i one         = _mm256_set1_epi32(1);
+      const __m256i seven       = _mm256_set1_epi32(7);
+      const __m256i split_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+      const bool    fastrange   = (fastrange_index == view.index_scheme);
+
+      std::size_t k = 0;
+
+      for (; k + 8 <= count; k += 8)
+      {
+         // every 64 bit hash is split into h1 (lower half) and h2 (upper half) for 8 keys
+         const __m256i hash_a = _mm256_permutevar8x32_epi32(mix64_avx2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + k    )), seed), split_halves);
+         const __m256i hash_b = _mm256_permutevar8x32_epi32(mix64_avx2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + k + 4)), seed), split_halves);
+
+         __m256i       probe = _mm256_permute2x128_si256(hash_a, hash_b, 0x20);
+         __m256i       step  = _mm256_permute2x128_si256(hash_a, hash_b, 0x31);
+         __m256i       alive = _mm256_set1_epi32(-1);
+
+         // fastrange steps through the table itself, see bloom_filter::probe_sequence
+         if (fastrange)
+         {
+            probe = fastrange_avx2(probe, table_size);
+            step  = fastrange_avx2(step, step_range);
+         }
+
+         step = _mm256_or_si256(step, one);
+
+         for (std::size_t i = 0; i < view.hash_count; ++i)
+         {
+            const __m256i bit_index = fastrange ? probe : _mm256_and_si256(probe, mask);
+
+            const __m256i word = _mm256_i32gather_epi32(reinterpret_cast<const int*>(view.table), _mm256_srli_epi32(bit_index, 3), 1);
+            const __m256i bit  = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(bit_index, seven)), one);
+
+            alive = _mm256_and_si256(alive, _mm256_sub_epi32(_mm256_setzero_si256(), bit));
+
+            if (_mm256_testz_si256(alive, alive))
+               break;
+
+            probe = _mm256_add_epi32(probe, step);
+
+            if (fastrange)
+            {
+               // x - table_size wraps around below 0 unless x >= table_size, hash_count < table_size so one subtraction is enough
+               probe = _mm256_min_epu32(probe, _mm256_sub_epi32(probe, wrap));
+               step  = _mm256_add_epi32(step, _mm256_set1_epi32(static_cast<int>(i + 1)));
+               step  = _mm256_min_epu32(step, _mm256_sub_epi32(step, wrap));
+            }
+         }
+
+         const unsigned long long int found = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(alive)));
+
+         result[k / 64] |= found << (k % 64);
+      }
+
+      return k;
+   }
+
+   // GCC 12 reports the undefined upper lanes used inside its own AVX-512 intrinsics as uninitialized
+   #if defined(__GNUC__) && !defined(__clang__)
+   #pragma GCC diagnostic push
+   #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+   #endif
+
+   __attribute__((target("avx512f,avx512dq")))
+   static inline __m512i mix64_avx512(const __m256i keys, const __m512i seed)
+   {
+      const __m512i multiplier = _mm512_set1_epi64(static_cast<long long>(0x9E3779B97F4A7C15ULL));
+
+      __m512i hash = _mm512_mullo_epi64(_mm512_xor_si512(seed, _mm512_cvtepu32_epi64(keys)), multiplier);
+
+      hash = _mm512_xor_si512(hash, _mm512_srli_epi64(hash, 33));
+      hash = _mm512_mullo_epi64(hash, _mm512_set1_epi64(static_cast<long long>(0xFF51AFD7ED558CCDULL)));
+      hash = _mm512_xor_si512(hash, _mm512_srli_epi64(hash, 33));
+      hash = _mm512_mullo_epi64(hash, _mm512_set1_epi64(static_cast<long long>(0xC4CEB9FE1A85EC53ULL)));
+      hash = _mm512_xor_si512(hash, _mm512_srli_epi64(hash, 33));
+
+      return hash;
+   }
+
+   __attribute__((target("avx512f,avx512dq")))
+   static inline __m512i fastrange_avx512(const __m512i x, const __m512i range)
+   {
+      const __m512i even = _mm512_srli_epi64(_mm512_mul_epu32(x, range), 32);
+      const __m512i odd  = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), range);
+
+      return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+   }
+
+   __attribute__((target("avx512f,avx512dq")))
+   static std::size_t contains_avx512(const table_view& view, const int* keys, const std::size_t count, unsigned long long int* result)
+   {
+      const __m512i seed       = _mm512_set1_epi64(static_cast<long long>(view.seed ^ (sizeof(int) * 0x9E3779B97F4A7C15ULL)));
+      const __m512i table_size = _mm512_set1_epi64(static_cast<long long>(view.table_size));
+      const __m512i step_range = _mm512_set1_epi64(static_cast<long long>(view.table_size - 1));
+      const __m512i wrap       = _mm512_set1_epi32(static_cast<int>(view.table_size));
+      const __m512i mask       = _mm512_set1_epi32(static_cast<int>(view.table_size - 1));
+      const __m512i one        = _mm512_set1_epi32(1);
+      const __m512i seven      = _mm512_set1_epi32(7);
+      const bool    fastrange  = (fastrange_index == view.index_scheme);
+
+      std::size_t k = 0;
+
+      for (; k + 16 <= count; k += 16)
+      {
+         const __m512i hash_a = mix64_avx512(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + k    )), seed);
+         const __m512i hash_b = mix64_avx512(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + k + 8)), seed);
+
+         // h1 (lower halves) and h2 (upper halves) of the 16 hashes
+         __m512i       probe = _mm512_inserti64x4(_mm512_zextsi256_si512(_mm512_cvtepi64_epi32(hash_a)), _mm512_cvtepi64_epi32(hash_b), 1);
+         __m512i       step  = _mm512_inserti64x4(_mm512_zextsi256_si512(_mm512_cvtepi64_epi32(_mm512_srli_epi64(hash_a, 32))),
+                                                  _mm512_cvtepi64_epi32(_mm512_srli_epi64(hash_b, 32)), 1);
+         __mmask16     alive = 0xFFFF;
+
+         if (fastrange)
+         {
+            probe = fastrange_avx512(probe, table_size);
+            step  = fastrange_avx512(step, step_range);
+         }
+
+         step = _mm512_or_si512(step, one);
+
+         for (std::size_t i = 0; alive && (i < view.hash_count); ++i)
+         {
+            const __m512i bit_index = fastrange ? probe : _mm512_and_si512(probe, mask);
+
+            const __m512i word = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), alive, _mm512_srli_epi32(bit_index, 3), view.table, 1);
+
+            alive = _mm512_mask_test_epi32_mask(alive, _mm512_srlv_epi32(word, _mm512_and_si512(bit_index, seven)), one);
+
+            probe = _mm512_add_epi32(probe, step);
+
+            if (fastrange)
+            {
+               probe = _mm512_min_epu32(probe, _mm512_sub_epi32(probe, wrap));
+               step  = _mm512_add_epi32(step, _mm512_set1_epi32(static_cast<int>(i + 1)));
+               step  = _mm512_min_epu32(step, _mm512_sub_epi32(step, wrap));
+            }
+         }
+
+         result[k / 64] |= static_cast<unsigned long long int>(alive) << (k % 64);
+      }
+
+      return k;
+   }
+
+   #if defined(__GNUC__) && !defined(__clang__)
+   #pragma GCC diagnostic pop
+   #endif
+   #endif
+};
+
+class bloom_filter_bank
+{
+   /*
+     Note:
+     A bank of many small bloom filters that all share the same false
+     positive probability and random seed. Every filter is identified by
+     the order in which it was added. Instead of every filter owning its
+     own bit table and salt vector, all bit tables live back to back in a
+     single buffer, filters with the same number of hashes share one salt
+     vector and the optimal parameters are only computed once for every
+     distinct projected element count. A filter of the bank answers
+     exactly like a bloom_filter constructed from the same parameters,
+     or like the blocked_bloom_filter or counting_bloom_filter of its
+     layout.
+     A filled bank can be written out with write_snapshot() and later
+     attached to the mapped bytes of that snapshot without copying the
+     filter records or the bit tables, such a bank is read only.
+   */
+
+protected:
+
+   typedef bloom_filter::bloom_type bloom_type;
+   typedef std::vector<bloom_cache_line> table_type;
+
+public:
+
+   typedef std::size_t filter_id;
+
+   bloom_filter_bank(const bloom_parameters& p)
+   : prototype_(p),
+     random_seed_((p.random_seed * 0xA5A5A5A5) + 1),
+     total_table_bytes_(0),
+     mapped_filters_(0),
+     mapped_filter_count_(0),
+     mapped_buffer_(0),
+     mapped_buffer_bytes_(0)
+   {}
+
+   inline void reserve(const std::size_t filter_count)
+   {
+      /*
+        Note:
+        Makes room for the records of filter_count filters, so a bank whose
+        filter count is known up front holds no unused record capacity.
+      */
+      filters_.reserve(filter_count);
+   }
+
+   inline filter_id add(const unsigned long long int projected_element_count, const bloom_filter_layout layout = standard_layout)
+   {
+      /*
+        Note:
+        Only reserves the filter, no bits are available until allocate()
+        has been called once after the last filter was added. Blocked
+        filters always start on a cache line boundary. Filters can still
+        be added to a filled bank, the filters that are already filled
+        keep their bits when allocate() is called again.
+      */
+      if ((blocked_layout == layout) && (0 != (total_table_bytes_ % blocked_bloom_filter::block_size)))
+      {
+         total_table_bytes_ += blocked_bloom_filter::block_size - (total_table_bytes_ % blocked_bloom_filter::block_size);
+      }
+
+      filter_record record;
+      record.offset         = total_table_bytes_;
+      record.parameter_set  = parameter_set_for(projected_element_count, layout);
+      record.inserted_count = 0;
+
+      total_table_bytes_ += table_bytes(parameter_sets_[record.parameter_set]);
+
+      filters_.push_back(record);
+
+      return filters_.size() - 1;
+   }
+
+   inline void allocate()
+   {
+      /*
+        Note:
+        Grows the buffer to hold every filter added so far, the new bytes
+        are zero. The buffer grows geometrically, so adding a few filters
+        at a time and allocating after each batch is amortized linear in
+        the number of filters. Any pointer into the old buffer is invalid
+        afterwards, so no other thread may query the bank meanwhile.
+      */
+      if (mapped_filters_)
+         return;
+
+      // one spare cache line so that the 4 byte loads of bloom_batch_query never read past the buffer
+      const std::size_t lines = static_cast<std::size_t>((total_table_bytes_ + sizeof(bloom_cache_line) - 1) / sizeof(bloom_cache_line)) + 1;
+
+      bit_buffer_.resize(lines, bloom_cache_line());
+   }
+
+   inline void clear()
+   {
+      std::fill(buffer(), buffer() + bit_buffer_.size() * sizeof(bloom_cache_line), static_cast<unsigned char>(0x00));
+
+      for (std::size_t i = 0; i < filters_.size(); ++i)
+      {
+         filters_[i].inserted_count = 0;
+      }
+   }
+
+   inline void insert(const filter_id id, const unsigned char* key_begin, const std::size_t& length)
+   {
+      /*
+        Note:
+        Different filters never share a byte of the buffer, so distinct
+        filters can be filled concurrently.
+      */
+      filter_record& record        = filters_[id];
+      const parameter_set& params  = parameter_sets_[record.parameter_set];
+      const std::vector<bloom_type>& salt = salt_sets_[params.salt_set];
+      unsigned char* table         = buffer() + record.offset;
+
+      ++record.inserted_count;
+
+      if (counting_layout == params.layout)
+      {
+         counting_bloom_filter::increment_counters(table, params.table_size, params.hash_count, random_seed_, prototype_.index_scheme, key_begin, length);
+         return;
+      }
+
+      if (blocked_layout == params.layout)
+      {
+         blocked_bloom_filter::insert_into_block(table, params.table_size / blocked_bloom_filter::bits_per_block, params.hash_count,
+                                                 random_seed_, key_begin, length);
+         return;
+      }
+
+      bloom_filter::probe_sequence probes(base_hash(key_begin, length), params.table_size, prototype_.index_scheme);
+
+      for (std::size_t i = 0; i < salt.size(); ++i)
+      {
+         const std::size_t bit_index = table_index(key_begin, length, probes, params.table_size, salt, i);
+
+         table[bit_index / bits_per_char] |= bit_mask[bit_index % bits_per_char];
+      }
+   }
+
+   template <typename T>
+   inline void insert(const filter_id id, const T& t)
+   {
+      // Note: T must be a C++ POD type.
+      insert(id, reinterpret_cast<const unsigned char*>(&t), sizeof(T));
+   }
+
+   inline bool contains(const filter_id id, const unsigned char* key_begin, const std::size_t length) const
+   {
+      const filter_record& record  = record_of(id);
+      const parameter_set& params  = parameter_sets_[record.parameter_set];
+      const std::vector<bloom_type>& salt = salt_sets_[params.salt_set];
+      const unsigned char* table   = buffer() + record.offset;
+
+      if (counting_layout == params.layout)
+      {
+         return counting_bloom_filter::counters_contain(table, params.table_size, params.hash_count, random_seed_, prototype_.index_scheme, key_begin, length);
+      }
+
+      if (blocked_layout == params.layout)
+      {
+         return blocked_bloom_filter::block_contains(table, params.table_size / blocked_bloom_filter::bits_per_block, params.hash_count,
+                                                     random_seed_, key_begin, length);
+      }
+
+      bloom_filter::probe_sequence probes(base_hash(key_begin, length), params.table_size, prototype_.index_scheme);
+
+      for (std::size_t i = 0; i < salt.size(); ++i)
+      {
+         const std::size_t bit_index = table_index(key_begin, length, probes, params.table_size, salt, i);
+
+         if ((table[bit_index / bits_per_char] & bit_mask[bit_index % bits_per_char]) == 0)
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   template <typename T>
+   inline bool contains(const filter_id id, const T& t) const
+   {
+      return contains(id, reinterpret_cast<const unsigned char*>(&t), static_cast<std::size_t>(sizeof(T)));
+   }
+
+   inline bool erase(const filter_id id, const unsigned char* key_begin, const std::size_t& length)
+   {
+      /*
+        Note:
+        Only counting_layout filters support erase, for any other layout
+        and for keys that are definitely not in the filter false is
+        returned and nothing changes. The same rules as for
+        counting_bloom_filter::erase apply.
+      */
+      filter_record& record       = filters_[id];
+      const parameter_set& params = parameter_sets_[record.parameter_set];
+
+      if (
+           (counting_layout != params.layout) ||
+           !counting_bloom_filter::decrement_counters(buffer() + record.offset, params.table_size, params.hash_count, random_seed_,
+                                                      prototype_.index_scheme, key_begin, length)
+         )
+         return false;
+
+      if (record.inserted_count > 0)
+         --record.inserted_count;
+
+      return true;
+   }
+
+   template <typename T>
+   inline bool erase(const filter_id id, const T& t)
+   {
+      return erase(id, reinterpret_cast<const unsigned char*>(&t), sizeof(T));
+   }
+
+   inline void clear(const filter_id id)
+   {
+      filter_record& record = filters_[id];
+
+      std::fill(buffer() + record.offset, buffer() + record.offset + table_bytes(parameter_sets_[record.parameter_set]), static_cast<unsigned char>(0x00));
+      record.inserted_count = 0;
+   }
+
+   inline void contains_batch(const filter_id id, const int* keys, const std::size_t count, unsigned long long int* result) const
+   {
+      /*
+        Note:
+        Bit i of result, which must hold (count + 63) / 64 words, is set
+        when keys[i] may be in the filter. standard_layout filters hashed with
+        double_hashing_mix64 are answered by the vector kernels of
+        bloom_batch_query, all others key by key.
+      */
+      const filter_record& record = record_of(id);
+      const parameter_set& params = parameter_sets_[record.parameter_set];
+
+      if ((standard_layout == params.layout) && (double_hashing_mix64 == prototype_.hash_scheme))
+      {
+         bloom_batch_query::table_view view;
+         view.table        = buffer() + record.offset;
+         view.table_size   = params.table_size;
+         view.hash_count   = params.hash_count;
+         view.seed         = random_seed_;
+         view.index_scheme = prototype_.index_scheme;
+
+         bloom_batch_query::contains(view, keys, count, result);
+      }
+      else
+      {
+         std::fill(result, result + (count + 63) / 64, 0ULL);
+
+         for (std::size_t k = 0; k < count; ++k)
+         {
+            if (contains(id, keys[k]))
+               result[k / 64] |= 1ULL << (k % 64);
+         }
+      }
+   }
+
+   inline std::size_t filter_count() const
+   {
+      return mapped_filters_ ? mapped_filter_count_ : filters_.size();
+   }
+
+   inline unsigned long long int table_bytes_for(const unsigned long long int projected_element_count, const bloom_filter_layout layout = standard_layout)
+   {
+      /*
+        Note:
+        Bytes of the table that add() reserves for such a filter, not
+        counting the cache line alignment of blocked filters. Computes
+        and keeps the parameter set the filter would use.
+      */
+      return table_bytes(parameter_sets_[parameter_set_for(projected_element_count, layout)]);
+   }
+
+   inline unsigned long long int size(const filter_id id) const
+   {
+      return parameter_sets_[record_of(id).parameter_set].table_size;
+   }
+
+   inline std::size_t hash_count(const filter_id id) const
+   {
+      return parameter_sets_[record_of(id).parameter_set].hash_count;
+   }
+
+   inline bloom_filter_layout layout(const filter_id id) const
+   {
+      return static_cast<bloom_filter_layout>(parameter_sets_[record_of(id).parameter_set].layout);
+   }
+
+   inline unsigned long long int element_count(const filter_id id) const
+   {
+      return record_of(id).inserted_count;
+   }
+
+   inline double effective_fpp(const filter_id id) const
+   {
+      const double k = static_cast<double>(hash_count(id));
+
+      return std::pow(1.0 - std::exp(-1.0 * k * element_count(id) / size(id)), k);
+   }
+
+   inline bool compatible(const filter_id a, const filter_id b) const
+   {
+      /*
+        Note:
+        Filters of the same parameter set set the same bits for the same
+        key, as the seed is shared by the whole bank. Counting filters
+        hold counters rather than bits, so they are never compatible.
+      */
+      const unsigned int parameter_set = record_of(a).parameter_set;
+
+      return (parameter_set == record_of(b).parameter_set) && (counting_layout != parameter_sets_[parameter_set].layout);
+   }
+
+   inline double approximate_element_count(const filter_id id) const
+   {
+      const filter_record& record = record_of(id);
+      const parameter_set& params = parameter_sets_[record.parameter_set];
+
+      if (counting_layout == params.layout)
+         return record.inserted_count;
+
+      return bloom_table_algebra::approximate_element_count(bloom_table_algebra::bit_count(buffer() + record.offset, static_cast<std::size_t>(table_bytes(params))),
+                                                            params.table_size, params.hash_count);
+   }
+
+   inline double jaccard(const filter_id a, const filter_id b) const
+   {
+      /*
+        Note:
+        Estimated Jaccard similarity of the keys of two filters, e.g. of
+        the common divisors of two nodes, 0 if they are not compatible().
+      */
+      if (!compatible(a, b))
+         return 0.0;
+
+      const parameter_set& params = parameter_sets_[record_of(a).parameter_set];
+
+      return bloom_table_algebra::jaccard(buffer() + record_of(a).offset, buffer() + record_of(b).offset, params.table_size, params.hash_count);
+   }
+
+   inline std::size_t memory_usage() const
+   {
+      std::size_t total = bit_buffer_.capacity() * sizeof(bloom_cache_line) + filters_.capacity() * sizeof(filter_record) +
+                          mapped_buffer_bytes_ + mapped_filter_count_ * sizeof(filter_record);
+
+      for (std::size_t i = 0; i < salt_sets_.size(); ++i)
+      {
+         total += salt_sets_[i].capacity() * sizeof(bloom_type);
+      }
+
+      return total;
+   }
+
+   inline std::size_t snapshot_size() const
+   {
+      std::size_t salt_count = 0;
+
+      for (std::size_t i = 0; i < salt_sets_.size(); ++i)
+      {
+         salt_count += salt_sets_[i].size();
+      }
+
+      return snapshot_align(sizeof(snapshot_header)) +
+             snapshot_align(parameter_sets_.size() * sizeof(parameter_set)) +
+             snapshot_align(salt_sets_.size() * sizeof(unsigned long long int)) +
+             snapshot_align(salt_count * sizeof(bloom_type)) +
+             snapshot_align(filter_count() * sizeof(filter_record)) +
+             snapshot_align(bit_buffer_.size() * sizeof(bloom_cache_line));
+   }
+
+   inline bool write_snapshot(std::ostream& os) const
+   {
+      /*
+        Note:
+        Writes snapshot_size() bytes in the native byte order, every
+        section is padded to a multiple of bloom_cache_line. The stream
+        should be positioned on a cache line boundary of the file so that
+        attach_snapshot() finds every section aligned once it is mapped.
+      */
+      if (mapped_filters_)
+         return false;
+
+      snapshot_header header;
+      std::memset(&header, 0, sizeof(header));
+      header.random_seed          = random_seed_;
+      header.hash_scheme          = prototype_.hash_scheme;
+      header.index_scheme         = prototype_.index_scheme;
+      header.parameter_set_count  = parameter_sets_.size();
+      header.salt_set_count       = salt_sets_.size();
+      header.filter_count         = filters_.size();
+      header.buffer_bytes         = bit_buffer_.size() * sizeof(bloom_cache_line);
+
+      std::vector<unsigned long long int> salt_set_sizes;
+      std::vector<bloom_type> salts;
+
+      for (std::size_t i = 0; i < salt_sets_.size(); ++i)
+      {
+         salt_set_sizes.push_back(salt_sets_[i].size());
+         salts.insert(salts.end(), salt_sets_[i].begin(), salt_sets_[i].end());
+      }
+
+      header.salt_count = salts.size();
+
+      write_snapshot_section(os, &header, sizeof(header));
+      write_snapshot_section(os, parameter_sets_.data(), parameter_sets_.size() * sizeof(parameter_set));
+      write_snapshot_section(os, salt_set_sizes.data(), salt_set_sizes.size() * sizeof(unsigned long long int));
+      write_snapshot_section(os, salts.data(), salts.size() * sizeof(bloom_type));
+      write_snapshot_section(os, filters_.data(), filters_.size() * sizeof(filter_record));
+      write_snapshot_section(os, buffer(), header.buffer_bytes);
+
+      return os.good();
+   }
+
+   inline bool attach_snapshot(const unsigned char* data, const std::size_t length, const std::size_t filter_count)
+   {
+      /*
+        Note:
+        data must stay valid for as long as the bank is used and must be
+        aligned to a bloom_cache_line. Only the parameter sets and salts,
+        a few hundred bytes, are copied. The filter records and the bit
+        tables are used in place, the records are only read once to be
+        checked. The snapshot has to come from a bank with the
+        same parameters and exactly filter_count filters, otherwise false
+        is returned and the bank is left unchanged. Every parameter set
+        and filter record is checked once, so a corrupt snapshot is
+        rejected instead of being read out of bounds by the queries.
+      */
+      if ((length < sizeof(snapshot_header)) || (0 != (reinterpret_cast<std::size_t>(data) % sizeof(bloom_cache_line))))
+         return false;
+
+      snapshot_header header;
+      std::memcpy(&header, data, sizeof(header));
+
+      if (
+           (header.random_seed  != random_seed_)                                   ||
+           (header.hash_scheme  != static_cast<unsigned int>(prototype_.hash_scheme))  ||
+           (header.index_scheme != static_cast<unsigned int>(prototype_.index_scheme))
+         )
+         return false;
+
+      if (
+           (header.parameter_set_count > length) || (header.salt_set_count > length) ||
+           (header.salt_count          > length) || (header.filter_count   > length) ||
+           (header.buffer_bytes        > length) || (header.filter_count  != filter_count)
+         )
+         return false;
+
+      const std::size_t section_bytes[] =
+                           {
+                             snapshot_align(sizeof(snapshot_header)),
+                             snapshot_align(header.parameter_set_count * sizeof(parameter_set)),
+                             snapshot_align(header.salt_set_count * sizeof(unsigned long long int)),
+                             snapshot_align(header.salt_count * sizeof(bloom_type)),
+                             snapshot_align(header.filter_count * sizeof(filter_record)),
+                             snapshot_align(header.buffer_bytes)
+                           };
+
+      std::size_t section_offset[7] = { 0 };
+
+      for (std::size_t i = 0; i < 6; ++i)
+      {
+         section_offset[i + 1] = section_offset[i] + section_bytes[i];
+      }
+
+      if (section_offset[6] > length)
+         return false;
+
+      std::vector<parameter_set> parameter_sets(header.parameter_set_count);
+      std::memcpy(parameter_sets.data(), data + section_offset[1], header.parameter_set_count * sizeof(parameter_set));
+
+      std::vector<std::vector<bloom_type> > salt_sets;
+      const unsigned long long int* salt_set_sizes = reinterpret_cast<const unsigned long long int*>(data + section_offset[2]);
+      const bloom_type*             salts          = reinterpret_cast<const bloom_type*>(data + section_offset[3]);
+      unsigned long long int        salts_used     = 0;
+
+      for (std::size_t i = 0; i < header.salt_set_count; ++i)
+      {
+         if (salt_set_sizes[i] > (header.salt_count - salts_used))
+            return false;
+
+         salt_sets.push_back(std::vector<bloom_type>(salts + salts_used, salts + salts_used + salt_set_sizes[i]));
+         salts_used += salt_set_sizes[i];
+      }
+
+      for (std::size_t i = 0; i < parameter_sets.size(); ++i)
+      {
+         const parameter_set& params = parameter_sets[i];
+
+         // a filter without keys has no table and no hashes, standard filters hash once per salt, blocked ones probe whole blocks
+         if (
+              (params.salt_set   >= salt_sets.size())                           ||
+              (params.layout     >  static_cast<unsigned int>(counting_layout)) ||
+              (params.table_size >  header.buffer_bytes * bits_per_char)       ||
+              ((0 == params.table_size) && (0 != params.hash_count))            ||
+              ((standard_layout == params.layout) && (params.hash_count != salt_sets[params.salt_set].size())) ||
+              ((standard_layout == params.layout) && (0 != (params.table_size % bits_per_char)))               ||
+              ((blocked_layout  == params.layout) && (0 != (params.table_size % blocked_bloom_filter::bits_per_block)))
+            )
+            return false;
+      }
+
+      const filter_record* records = reinterpret_cast<const filter_record*>(data + section_offset[4]);
+
+      for (std::size_t i = 0; i < header.filter_count; ++i)
+      {
+         if (
+              (records[i].parameter_set >= parameter_sets.size()) ||
+              (records[i].offset        >  header.buffer_bytes)   ||
+              (table_bytes(parameter_sets[records[i].parameter_set]) > (header.buffer_bytes - records[i].offset))
+            )
+            return false;
+      }
+
+      parameter_sets_.swap(parameter_sets);
+      salt_sets_.swap(salt_sets);
+      parameter_set_index_.clear();
+      filters_.clear();
+      bit_buffer_.clear();
+      total_table_bytes_ = header.buffer_bytes;
+
+      mapped_filters_      = records;
+      mapped_filter_count_ = header.filter_count;
+      mapped_buffer_       = data + section_offset[5];
+      mapped_buffer_bytes_ = header.buffer_bytes;
+
+      return true;
+   }
+
+protected:
+
+   struct snapshot_header
+   {
+      unsigned long long int random_seed;
+      unsigned int           hash_scheme;
+      unsigned int           index_scheme;
+      unsigned long long int parameter_set_count;
+      unsigned long long int salt_set_count;
+      unsigned long long int salt_count;
+      unsigned long long int filter_count;
+      unsigned long long int buffer_bytes;
+   };
+
+   static inline std::size_t snapshot_align(const std::size_t bytes)
+   {
+      return (bytes + sizeof(bloom_cache_line) - 1) / sizeof(bloom_cache_line) * sizeof(bloom_cache_line);
+   }
+
+   static inline void write_snapshot_section(std::ostream& os, const void* data, const std::size_t bytes)
+   {
+      static const char padding[sizeof(bloom_cache_line)] = { 0 };
+
+      os.write(reinterpret_cast<const char*>(data), bytes);
+      os.write(padding, snapshot_align(bytes) - bytes);
+   }
+
+   struct parameter_set
+   {
+      unsigned long long int table_size;
+      std::size_t            salt_set;
+      std::size_t            hash_count;
+      unsigned int           layout;
+   };
+
+   typedef std::pair<unsigned long long int, bloom_filter_layout> parameter_key;
+
+   struct filter_record
+   {
+      unsigned long long int offset;          // in bytes from the start of bit_buffer_
+      unsigned int           parameter_set;
+      unsigned int           inserted_count;
+   };
+
+   inline unsigned int parameter_set_for(const unsigned long long int projected_element_count, const bloom_filter_layout layout)
+   {
+      const parameter_key key(projected_element_count, layout);
+
+      std::map<parameter_key, unsigned int>::const_iterator itr = parameter_set_index_.find(key);
+
+      if (parameter_set_index_.end() != itr)
+         return itr->second;
+
+      parameter_set params;
+      params.layout = standard_layout;
+
+      if (0 == projected_element_count)
+      {
+         // Same as a default constructed bloom_filter: no table, no salt.
+         params.table_size = 0;
+         params.salt_set   = salt_set_for(bloom_filter().salt_);
+         params.hash_count = 0;
+      }
+      else
+      {
+         bloom_parameters p = prototype_;
+         p.projected_element_count = projected_element_count;
+         p.compute_optimal_parameters();
+
+         if (blocked_layout == layout)
+         {
+            params.table_size = blocked_bloom_filter::block_count_for(p.optimal_parameters.table_size) * blocked_bloom_filter::bits_per_block;
+            params.salt_set   = salt_set_for(std::vector<bloom_type>());
+            params.hash_count = p.optimal_parameters.number_of_hashes;
+            params.layout     = blocked_layout;
+         }
+         else if (counting_layout == layout)
+         {
+            params.table_size = p.optimal_parameters.table_size;
+            params.salt_set   = salt_set_for(std::vector<bloom_type>());
+            params.hash_count = p.optimal_parameters.number_of_hashes;
+            params.layout     = counting_layout;
+         }
+         else
+         {
+            params.table_size = p.optimal_parameters.table_size;
+            params.salt_set   = salt_set_for(bloom_filter(p).salt_);
+            params.hash_count = salt_sets_[params.salt_set].size();
+         }
+      }
+
+      parameter_sets_.push_back(params);
+
+      const unsigned int index = static_cast<unsigned int>(parameter_sets_.size() - 1);
+
+      parameter_set_index_[key] = index;
+
+      return index;
+   }
+
+   inline std::size_t salt_set_for(const std::vector<bloom_type>& salt)
+   {
+      for (std::size_t i = 0; i < salt_sets_.size(); ++i)
+      {
+         if (salt_sets_[i] == salt)
+            return i;
+      }
+
+      salt_sets_.push_back(salt);
+
+      return salt_sets_.size() - 1;
+   }
+
+   inline unsigned long long int base_hash(const unsigned char* key_begin, const std::size_t length) const
+   {
+      return (double_hashing_mix64 == prototype_.hash_scheme) ? bloom_filter::hash_mix64(key_begin, length, random_seed_) : 0;
+   }
+
+   inline std::size_t table_index(const unsigned char* key_begin, const std::size_t length, bloom_filter::probe_sequence& probes,
+                                  const unsigned long long int table_size, const std::vector<bloom_type>& salt, const std::size_t i) const
+   {
+      if (double_hashing_mix64 == prototype_.hash_scheme)
+         return probes.next();
+      else
+         return bloom_filter::reduce(bloom_filter::hash_ap(key_begin, length, salt[i]), table_size, prototype_.index_scheme);
+   }
+
+   inline unsigned char* buffer()
+   {
+      return reinterpret_cast<unsigned char*>(bit_buffer_.data());
+   }
+
+   inline const unsigned char* buffer() const
+   {
+      return mapped_buffer_ ? mapped_buffer_ : reinterpret_cast<const unsigned char*>(bit_buffer_.data());
+   }
+
+   static inline unsigned long long int table_bytes(const parameter_set& params)
+   {
+      return (counting_layout == params.layout) ? counting_bloom_filter::table_bytes_for(params.table_size) : params.table_size / bits_per_char;
+   }
+
+   inline const filter_record& record_of(const filter_id id) const
+   {
+      return mapped_filters_ ? mapped_filters_[id] : filters_[id];
+   }
+
+   bloom_parameters                               prototype_;
+   unsigned long long int                         random_seed_;
+   std::vector<std::vector<bloom_type> >          salt_sets_;
+   std::vector<parameter_set>                     parameter_sets_;
+   std::map<parameter_key, unsigned int>          parameter_set_index_;
+   std::vector<filter_record>                     filters_;
+   table_type                                     bit_buffer_;
+   unsigned long long int                         total_table_bytes_;
+   const filter_record*                           mapped_filters_;
+   std::size_t                                    mapped_filter_count_;
+   const unsigned char*                           mapped_buffer_;
+   std::size_t                                    mapped_buffer_bytes_;
+};
+
 #endif
 
 
@@ -732,4 +2807,7 @@ private:
   Note 2:
   For performance reasons where possible when allocating memory it should
   be aligned (aligned_alloc) according to the architecture being used.
+  bloom_filter tables are allocated by bloom_aligned_allocator and the
+  bloom_filter_bank buffer is made of bloom_cache_line, both start on a
+  64 byte boundary.
 */
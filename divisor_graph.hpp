@@ -0,0 +1,774 @@
+#ifndef INCLUDE_DIVISOR_GRAPH_HPP
+#define INCLUDE_DIVISOR_GRAPH_HPP
+
+#include <algorithm>
+#include <charconv>	 // to_chars for printing the graph
+#include <cmath>	 // sqrt, the bound of the trial division
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>  // rename
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>	// iota
+#include <ostream>
+#include <stack>   // used for the baseline DFS
+#include <string>
+#include <thread>  // used to build the graph on every core
+#include <vector>
+
+#include <fcntl.h>	// open, mmap and friends for mapping snapshots
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bloom_filter.hpp"
+#include "false_positive_cache.hpp"	 // hash table with CLOCK eviction for caching false +ve results from bloom filter
+#include "node_filters.hpp"			 // the interface every kind of node filter is used through
+#include "prime_labels.hpp"			 // exact reachability labels read off the compressed graph
+#include "query_stats.hpp"			 // per stage counters and latency histograms of the queries
+
+inline int workerCount() { return std::max(1u, std::thread::hardware_concurrency()); }	// hardware_concurrency() is allowed to return 0 when it cant tell
+
+// splits the nodes [firstNode, lastNode] into one contiguous chunk per core and runs work(chunkFirst, chunkLast) on each chunk in parallel
+// chunks never overlap, so workers can write to the rows of their own chunk without any locking
+inline void parallelForEachChunk(const int firstNode, const int lastNode, const std::function<void(int, int)> &work) {
+	const int totalNodes = lastNode - firstNode + 1;
+	const int totalWorkers = std::min(totalNodes, workerCount());
+	const int chunkLen = (totalNodes + totalWorkers - 1) / totalWorkers;
+
+	std::vector<std::thread> workers;
+	for (int chunkFirst = firstNode; chunkFirst <= lastNode; chunkFirst += chunkLen)
+		workers.emplace_back(work, chunkFirst, std::min(lastNode, chunkFirst + chunkLen - 1));
+	for (std::thread &worker: workers) worker.join();
+}
+
+// immutable compressed sparse row(CSR) representation of the compressed graph
+// the factors of node n are stored back to back in targets[offsets[n]] .. targets[offsets[n + 1] - 1]
+// so a DFS step reads one contiguous run of ints instead of chasing a pointer to a separately allocated vector for every node
+// the arrays are owned by whoever built or mapped the graph, so the same struct works for a graph in memory and one mapped from a snapshot
+struct CSRGraph {
+	const unsigned int *offsets = nullptr;	// rowCount + 1 entries, rows 0 and 1 are empty
+	const int *targets = nullptr;			// every row is sorted in ascending order
+	std::size_t rowCount = 0;				// totalNodes + 1, node n is row n
+
+	const int *neighboursBegin(const int node) const { return targets + offsets[node]; }
+	const int *neighboursEnd(const int node) const { return targets + offsets[node + 1]; }
+	std::size_t edgeCount() const { return rowCount ? offsets[rowCount] : 0; }
+	std::size_t memoryUsage() const { return (rowCount ? rowCount + 1 : 0) * sizeof(unsigned int) + edgeCount() * sizeof(int); }
+};
+
+// read only mapping of a whole file, its pages are shared with the page cache and only read from disk when they are first touched
+class MappedFile {
+   public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	~MappedFile() { unmap(); }
+
+	bool map(const std::string &path) {
+		unmap();
+		const int descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor < 0) return false;
+
+		struct stat info;
+		if (fstat(descriptor, &info) == 0 and info.st_size > 0) {
+			void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (mapped != MAP_FAILED) bytes = (const unsigned char *)mapped, length = info.st_size;
+		}
+		close(descriptor);	// the mapping stays valid without the descriptor
+		return bytes != nullptr;
+	}
+
+	void unmap() {
+		if (bytes) munmap((void *)bytes, length);
+		bytes = nullptr, length = 0;
+	}
+
+	const unsigned char *data() const { return bytes; }
+	std::size_t size() const { return length; }
+
+   private:
+	const unsigned char *bytes = nullptr;  // page aligned, so every 64 byte aligned offset into the file is a 64 byte aligned address
+	std::size_t length = 0;
+};
+
+enum GraphFormat {
+	TEXT_FORMAT,	   // "Factors of n : a b c" per node, the format the graph was always printed in
+	EDGE_LIST_FORMAT,  // "n a" per edge
+	DOT_FORMAT		   // graphviz digraph, nodes without edges(primes) are listed on their own
+};
+
+enum DFSMode {
+	BASELINE_DFS,  // the original DFS, expands a node again for every path that reaches it
+	PRUNED_DFS,		   // expands every node at most once and never descends into nodes smaller than the number being searched
+	FILTER_PRUNED_DFS  // PRUNED_DFS that also skips every node whose node filter rules out the number being searched
+};
+
+// everything that used to be a compile time constant of main.cpp, so that one process can build differently tuned graphs
+struct GraphConfig {
+	int totalNodes = 20001;					// total nodes in the entire graph
+	double falsePositivityRateInPC = 1;		// false +ve target of every node filter
+	int cacheLenLimit = -1;					// negative means falsePositivityRateInPC % of totalNodes, the share of queries expected to be false +ve
+	NodeFilterType filterType = STANDARD_BLOOM_FILTER;	// see NodeFilterType, only counting bloom filters let nodes be removed and restored
+	bool exactSmallNodes = false;						// nodes whose factors fit in no more bytes than their filter get an exact set, see ExactSetFilterBank
+	bool queryStats = false;							// count and time every stage of searchUsingBloomFilter(), see QueryStats
+
+	int cacheCapacity() const { return cacheLenLimit >= 0 ? cacheLenLimit : (int)(falsePositivityRateInPC * totalNodes / 100); }
+};
+
+// how long every phase of the last build() or extend() took, and of the last labelNodes()
+struct BuildTimings {
+	std::chrono::nanoseconds factor{0};	   // finding the factors of every node
+	std::chrono::nanoseconds filter{0};	   // sizing, allocating and filling the node filters
+	std::chrono::nanoseconds compress{0};  // compressing the rows and packing them into the CSR
+	std::chrono::nanoseconds label{0};
+};
+
+// the divisor graph of 2 .. totalNodes together with the bloom filter of every node and the cache of false +ve results
+// a graph owns everything it needs, so graphs of different sizes and filter settings can be built and queried one after another
+class DivisorGraph {
+   public:
+	explicit DivisorGraph(const GraphConfig &config)
+		: config(config), totalNodes(config.totalNodes), filterType(config.filterType),
+		  nodeFilters(createNodeFilters(config)), falsePositiveCache(config.cacheCapacity()) {
+		queryStats.enable(config.queryStats);
+	}
+
+	// factorizes every node, fills the bloom filters from the uncompressed graph and then compresses it, returns how long it took
+	std::chrono::nanoseconds build() {
+		const auto buildStart = std::chrono::steady_clock::now();
+
+		std::vector<std::vector<int>> factorLists(totalNodes + 1);	// uncompressed graph, only needed until the filters are built and the rows are compressed
+
+		// Building the adjacency list for uncompressed graph
+		parallelForEachChunk(2, totalNodes, [&](const int firstNode, const int lastNode) { collectFactors(factorLists, firstNode, lastNode); });
+		const auto factorsFound = std::chrono::steady_clock::now();
+		timings.factor = factorsFound - buildStart;
+
+		// factors for all elements have been found, so we know exactly how many factors does a number have
+		// setting up bloom filters from uncompressed graph with size=number of factors of that number
+		nodeFilters->reserve(totalNodes + 1);
+		createBloomFilter(0), createBloomFilter(1);										   // 0 is not part of the graph, 1 is its own only factor
+		for (int i = 2; i <= totalNodes; i++) createBloomFilter(factorLists[i].size() + 2);  // create bloom filter that can hold all factors, 1 and the number itself
+		nodeFilters->allocate();															   // a single allocation for the tables of every node
+		const int one = 1;
+		nodeFilters->build(1, &one, 1);
+		parallelForEachChunk(2, totalNodes, [&](const int firstNode, const int lastNode) { fillNodeFilters(factorLists, 0, firstNode, lastNode); });
+		const auto filtersFilled = std::chrono::steady_clock::now();
+		timings.filter = filtersFilled - factorsFound;
+
+		// Compressing the graph inplace, every row is independent so the rows are compressed in parallel
+		const std::vector<int> smallestPrimeFactor = buildSmallestPrimeFactors();
+		parallelForEachChunk(2, totalNodes, [&](const int firstNode, const int lastNode) {
+			for (int i = firstNode; i <= lastNode; i++) compressFactors(i, factorLists[i], smallestPrimeFactor);
+		});
+		packIntoCSR(factorLists);
+
+		const auto buildEnd = std::chrono::steady_clock::now();
+		timings.compress = buildEnd - filtersFilled;
+		return buildEnd - buildStart;
+	}
+
+	// grows a built graph from totalNodes to newTotalNodes without rebuilding it, returns how long it took or -1ns if the graph cant grow
+	// every factor of a new node is smaller than it, so the rows, filters and cached false +ve of the old nodes never change
+	// only the new rows are factorized, filled and compressed(in parallel, like build()) and appended to the CSR and the filter bank,
+	// both grow geometrically so growing a graph step by step costs time proportional to the new nodes
+	// a graph mapped from a snapshot is read only and can not grow, and no other thread may query the graph while it grows
+	std::chrono::nanoseconds extend(const int newTotalNodes) {
+		if (snapshot.data() != nullptr or graph.rowCount == 0 or newTotalNodes <= totalNodes) return std::chrono::nanoseconds(-1);
+		const auto extendStart = std::chrono::steady_clock::now();
+		const int firstNewNode = totalNodes + 1;
+
+		std::vector<std::vector<int>> factorLists(newTotalNodes - totalNodes);	// factorLists[i] is the row of node firstNewNode + i
+		parallelForEachChunk(firstNewNode, newTotalNodes, [&](const int firstNode, const int lastNode) {
+			collectFactors(factorLists, firstNode, lastNode, firstNewNode);
+		});
+		const auto factorsFound = std::chrono::steady_clock::now();
+		timings.factor = factorsFound - extendStart;
+
+		// no reserve() here, reserving exactly newTotalNodes + 1 records would copy every record on every step of a growing graph
+		for (const std::vector<int> &factors: factorLists) createBloomFilter(factors.size() + 2);
+		nodeFilters->allocate();  // keeps the keys of the old filters
+		if (not removedNodes.empty()) removedNodes.resize(newTotalNodes + 1, 0);
+		parallelForEachChunk(firstNewNode, newTotalNodes, [&](const int firstNode, const int lastNode) {
+			fillNodeFilters(factorLists, firstNewNode, firstNode, lastNode);
+		});
+		const auto filtersFilled = std::chrono::steady_clock::now();
+		timings.filter = filtersFilled - factorsFound;
+
+		parallelForEachChunk(firstNewNode, newTotalNodes, [&](const int firstNode, const int lastNode) {
+			for (int i = firstNode; i <= lastNode; i++) compressFactorsOfRow(i, factorLists[i - firstNewNode]);
+		});
+		appendToCSR(factorLists);
+		timings.compress = std::chrono::steady_clock::now() - filtersFilled;
+
+		totalNodes = config.totalNodes = newTotalNodes;
+		if (labelIndex.nodeCount() > 0) labelNodes();  // only the new nodes
+		if (config.cacheLenLimit < 0) resizeCache(config.cacheCapacity());	// the cache keeps its share of the nodes
+		return std::chrono::steady_clock::now() - extendStart;
+	}
+
+	// snapshot file: a SnapshotHeader, the CSR offsets, the CSR targets and the filter bank, each section starts on a 64 byte boundary
+	// the numbers are stored in the byte order of the machine, a snapshot is a cache of build() and not an exchange format
+	// written to a temporary file first and renamed over path, so a crash never leaves a half written snapshot behind
+	// only bloom filters can be saved, every other kind is rebuilt
+	bool saveSnapshot(const std::string &path) const {
+		if (nodeFilters->snapshotSize() == 0) return false;
+
+		SnapshotHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+		header.version = SNAPSHOT_VERSION;
+		header.filterType = filterType;
+		header.totalNodes = totalNodes;
+		header.falsePositivityRateInPC = config.falsePositivityRateInPC;
+		header.edgeCount = graph.edgeCount();
+		header.bankBytes = nodeFilters->snapshotSize();
+
+		const std::string temporaryPath = path + ".tmp";
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		writeSnapshotSection(file, &header, sizeof(header));
+		writeSnapshotSection(file, graph.offsets, (graph.rowCount + 1) * sizeof(unsigned int));
+		writeSnapshotSection(file, graph.targets, graph.edgeCount() * sizeof(int));
+		const bool written = nodeFilters->writeSnapshot(file) and file.flush();
+		file.close();
+
+		if (written and std::rename(temporaryPath.c_str(), path.c_str()) == 0) return true;
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	// maps a snapshot written by saveSnapshot() instead of calling build(), nothing is parsed or copied, only the offsets, the targets and the
+	// filter records are checked in one pass(12 ms for 1000001 nodes) so that a corrupt snapshot is rebuilt instead of read out of bounds
+	// returns false and leaves the graph empty if the file is missing, truncated, corrupt, of another version or was saved with a different configuration
+	bool loadSnapshot(const std::string &path) {
+		if (not snapshot.map(path) or snapshot.size() < sizeof(SnapshotHeader)) return false;
+
+		SnapshotHeader header;
+		std::memcpy(&header, snapshot.data(), sizeof(header));
+		const std::size_t offsetsAt = snapshotAlign(sizeof(SnapshotHeader));
+		const std::size_t targetsAt = offsetsAt + snapshotAlign((totalNodes + 2) * sizeof(unsigned int));
+		const std::size_t bankAt = header.edgeCount <= snapshot.size() ? targetsAt + snapshotAlign(header.edgeCount * sizeof(int)) : snapshot.size() + 1;
+
+		const bool matches = std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 and header.version == SNAPSHOT_VERSION and
+							 header.filterType == filterType and header.totalNodes == totalNodes and
+							 header.falsePositivityRateInPC == config.falsePositivityRateInPC and bankAt <= snapshot.size() and
+							 header.bankBytes <= snapshot.size() - bankAt and
+							 validSnapshotRows((const unsigned int *)(snapshot.data() + offsetsAt), (const int *)(snapshot.data() + targetsAt), header.edgeCount);
+		if (not matches or not nodeFilters->attachSnapshot(snapshot.data() + bankAt, header.bankBytes, totalNodes + 1)) {
+			snapshot.unmap();
+			return false;
+		}
+
+		ownedOffsets.clear(), ownedTargets.clear();
+		labelIndex = PrimeLabelIndex();
+		graph.offsets = (const unsigned int *)(snapshot.data() + offsetsAt);
+		graph.targets = (const int *)(snapshot.data() + targetsAt);
+		graph.rowCount = totalNodes + 1;
+		return true;
+	}
+
+	// formats the nodes in chunks, every core formats its own chunk with to_chars into its own buffer and the buffers are written in order
+	// with a single write each, so dumping a huge graph is bound by the output and not by pushing every number through an ostream
+	void printGraph(std::ostream &out, const GraphFormat format = TEXT_FORMAT) const {
+		const long long nodesPerChunk = 1 << 16;
+		std::vector<std::vector<char>> chunks(workerCount());
+
+		if (format == DOT_FORMAT) out << "digraph divisors {\n";
+		for (long long groupFirst = 2; groupFirst <= totalNodes; groupFirst += nodesPerChunk * chunks.size()) {
+			const int chunksInGroup = std::min<long long>(chunks.size(), (totalNodes - groupFirst) / nodesPerChunk + 1);
+			parallelForEachChunk(0, chunksInGroup - 1, [&](const int firstChunk, const int lastChunk) {
+				for (int c = firstChunk; c <= lastChunk; c++) {
+					const long long first = groupFirst + c * nodesPerChunk;
+					formatNodes(first, std::min<long long>(totalNodes, first + nodesPerChunk - 1), format, chunks[c]);
+				}
+			});
+			for (int c = 0; c < chunksInGroup; c++) out.write(chunks[c].data(), chunks[c].size());
+		}
+		if (format == DOT_FORMAT) out << "}\n";
+		out.flush();
+	}
+
+	// measures the false +ve rate of the node filters and compares it with the rate the filters expect from their own load
+	// every number greater than i is definitely not a factor of i, so every time the filter of i contains one of them it is a false +ve
+	void reportFilterAccuracy(std::ostream &out) const {
+		const int sampleStride = std::max(1, totalNodes / 100000);	// sample at most ~100000 filters so that huge graphs are reported quickly
+		const int probesPerFilter = 64;
+
+		long long totalProbes = 0, falsePositives = 0;
+		double expectedFalsePositives = 0;
+		for (int i = 2; i <= totalNodes; i += sampleStride) {
+			for (int probe = i + 1; probe <= i + probesPerFilter; probe++) falsePositives += nodeFilters->contains(i, probe);
+			totalProbes += probesPerFilter;
+			expectedFalsePositives += nodeFilters->effectiveFpp(i) * probesPerFilter;
+		}
+
+		out << nodeFilters->name() << ": measured false +ve rate " << 100.0 * falsePositives / totalProbes << "% vs "
+			<< 100.0 * expectedFalsePositives / totalProbes << "% expected by effective_fpp()" << std::endl;
+	}
+
+	// labels every node that is not labelled yet with its prime powers, read off its compressed row, returns how long it took
+	// only searchUsingLabels() needs the labels, so they are built on demand and then kept up to date by extend()
+	std::chrono::nanoseconds labelNodes() {
+		const auto labelStart = std::chrono::steady_clock::now();
+		const int firstNode = std::max(labelIndex.nodeCount() + 1, 2);
+		labelIndex.grow(totalNodes, graph.offsets);
+		if (firstNode <= totalNodes)
+			parallelForEachChunk(firstNode, totalNodes, [&](const int first, const int last) {
+				for (int node = first; node <= last; node++) labelIndex.label(node, graph.neighboursBegin(node), graph.neighboursEnd(node));
+			});
+		timings.label = std::chrono::steady_clock::now() - labelStart;
+		return timings.label;
+	}
+
+	bool labelled() const { return labelIndex.nodeCount() == totalNodes; }
+
+	// answers exactly what the DFS would from the labels of both numbers, in a few divisions whatever the size of the graph
+	// labelNodes() must have been called since the graph was built, grown or mapped
+	bool searchUsingLabels(const int isThisNumber, const int aFactorOfThisNumber) const {
+		if (isThisNumber < 1 or aFactorOfThisNumber < 1 or isRemoved(isThisNumber) or isRemoved(aFactorOfThisNumber)) return false;
+		return labelIndex.divides(isThisNumber, aFactorOfThisNumber);
+	}
+
+	bool searchUsingDFS(const int isThisNumber, const int aFactorOfThisNumber, const DFSMode mode = PRUNED_DFS) const {
+		if (isRemoved(isThisNumber) or isRemoved(aFactorOfThisNumber)) return false;  // removed nodes only stay in the graph to keep their factors reachable
+		if (isThisNumber == 1) return true;
+		if (mode == BASELINE_DFS) return searchUsingBaselineDFS(isThisNumber, aFactorOfThisNumber);
+		return searchUsingPrunedDFS(isThisNumber, aFactorOfThisNumber, mode == FILTER_PRUNED_DFS);
+	}
+
+	// safe to call from many threads at once: the graph and the filters are never modified after build(),
+	// every thread has its own DFS scratch space and the false +ve cache locks only the shard that the key belongs to
+	bool searchUsingBloomFilter(const int isThisNumber, const int aFactorOfThisNumber) {
+		const auto queryStart = queryStats.start();
+		const bool result = nodeFilters->contains(aFactorOfThisNumber, isThisNumber);
+		queryStats.finish(FILTER_STAGE, queryStart);
+		if (result == false) {	// if result==false, then result is definately false
+			queryStats.count(FILTER_NEGATIVES);
+			queryStats.finish(TOTAL_STAGE, queryStart);
+			return false;
+		}
+		queryStats.count(FILTER_POSITIVES);
+
+		if (nodeFilters->exact(aFactorOfThisNumber)) {	// an exact set has no false +ve to confirm
+			queryStats.count(EXACT_POSITIVES), queryStats.count(TRUE_POSITIVES);
+			queryStats.finish(TOTAL_STAGE, queryStart);
+			return true;
+		}
+
+		const bool confirmed = confirmProbableFactor(isThisNumber, aFactorOfThisNumber);
+		queryStats.finish(TOTAL_STAGE, queryStart);
+		return confirmed;
+	}
+
+	// asks the bloom filter of the number about every candidate from 1 to the number itself in one batch query
+	// the batch query hashes and probes many candidates per instruction, so only the probable factors are left for the cache and DFS
+	std::vector<int> findFactorsUsingBloomFilter(const int ofThisNumber) {
+		std::vector<int> candidates(ofThisNumber);
+		std::iota(candidates.begin(), candidates.end(), 1);
+
+		std::vector<unsigned long long> probableFactors((candidates.size() + 63) / 64);	 // bit i is set if candidates[i] is a probable factor
+		nodeFilters->containsBatch(ofThisNumber, candidates.data(), candidates.size(), probableFactors.data());
+
+		if (queryStats.isEnabled()) {
+			std::size_t positives = 0;
+			for (const unsigned long long word: probableFactors) positives += __builtin_popcountll(word);
+			queryStats.count(FILTER_POSITIVES, positives);
+			queryStats.count(FILTER_NEGATIVES, candidates.size() - positives);
+		}
+
+		std::vector<int> factors;
+		const bool exactSet = nodeFilters->exact(ofThisNumber);
+		for (std::size_t i = 0; i < candidates.size(); i++)
+			if ((probableFactors[i / 64] >> (i % 64) & 1) and (exactSet or confirmProbableFactor(candidates[i], ofThisNumber))) factors.push_back(candidates[i]);
+		if (exactSet) queryStats.count(EXACT_POSITIVES, factors.size()), queryStats.count(TRUE_POSITIVES, factors.size());
+		return factors;
+	}
+
+	// takes node out of the graph, every query about it answers false until it is restored
+	// node is erased from the counting filters of its multiples and its own filter is emptied, so the bloom filters keep answering most
+	// queries about it on their own, the DFS still walks through it so that the factors of node stay reachable from its multiples
+	// only graphs with counting filters that were built in memory can be updated, and never while other threads are querying
+	bool removeNode(const int node) {
+		if (not updatable(node) or isRemoved(node)) return false;
+		if (removedNodes.empty()) removedNodes.assign(totalNodes + 1, 0);
+
+		for (int multiple = 2 * node; multiple <= totalNodes; multiple += node)
+			if (not isRemoved(multiple)) nodeFilters->erase(multiple, node);
+		nodeFilters->clear(node);
+		removedNodes[node] = 1;
+		return true;	// the cached false +ve stay false, nothing to invalidate
+	}
+
+	// puts a removed node back, refilling the filters with it and forgetting every cached false +ve that is true again
+	bool restoreNode(const int node) {
+		if (not updatable(node) or not isRemoved(node)) return false;
+		removedNodes[node] = 0;
+
+		for (const int factor: factorsOf(node))
+			if (not isRemoved(factor)) {
+				nodeFilters->insert(node, factor);
+				falsePositiveCache.erase(factor, node);
+			}
+		for (int multiple = 2 * node; multiple <= totalNodes; multiple += node)
+			if (not isRemoved(multiple)) {
+				nodeFilters->insert(multiple, node);
+				falsePositiveCache.erase(node, multiple);
+			}
+		return true;
+	}
+
+	bool isRemoved(const int node) const { return not removedNodes.empty() and node >= 2 and node <= totalNodes and removedNodes[node]; }
+
+	void resizeCache(const int cacheLenLimit) { falsePositiveCache.resize(cacheLenLimit); }	 // also drops every cached false +ve
+
+	int nodeCount() const { return totalNodes; }
+	const GraphConfig &configuration() const { return config; }
+	std::size_t memoryUsage() const { return graph.memoryUsage() + nodeFilters->memoryUsage() + falsePositiveCache.memoryUsage() + labelIndex.memoryUsage(); }
+	const CSRGraph &compressedGraph() const { return graph; }
+	const NodeFilterBank &filters() const { return *nodeFilters; }
+	const ShardedFalsePositiveCache &cache() const { return falsePositiveCache; }
+	const PrimeLabelIndex &labels() const { return labelIndex; }
+	const QueryStats &stats() const { return queryStats; }
+	const BuildTimings &buildTimings() const { return timings; }
+
+	// writes the query counters and latency histograms next to the build phase timings and the false +ve rate the filters aim for
+	// the observed false +ve rate of the counters is directly comparable with expected_false_positive_rate, the mean effective_fpp() of
+	// the nodes, and with target_false_positive_rate, the falsePositivityRateInPC every filter was sized for
+	void writeStats(std::ostream &out, const StatsFormat format = JSON_STATS) const {
+		const int sampleStride = std::max(1, totalNodes / 100000);
+		double effectiveFpp = 0;
+		int sampled = 0;
+		for (int i = 2; i <= totalNodes; i += sampleStride, sampled++) effectiveFpp += nodeFilters->effectiveFpp(i);
+
+		const auto milliseconds = [](const std::chrono::nanoseconds time) { return std::chrono::duration<double, std::milli>(time).count(); };
+		const QueryStats::Gauges gauges = {{"nodes", (double)totalNodes},
+										   {"target_false_positive_rate", config.falsePositivityRateInPC / 100},
+										   {"expected_false_positive_rate", sampled ? effectiveFpp / sampled : 0},
+										   {"cached_false_positives", (double)falsePositiveCache.size()},
+										   {"memory_bytes", (double)memoryUsage()},
+										   {"build_factor_ms", milliseconds(timings.factor)},
+										   {"build_filter_ms", milliseconds(timings.filter)},
+										   {"build_compress_ms", milliseconds(timings.compress)},
+										   {"build_label_ms", milliseconds(timings.label)}};
+		if (format == PROMETHEUS_STATS) queryStats.writePrometheus(out, gauges);
+		else queryStats.writeJSON(out, gauges);
+	}
+
+   private:
+	GraphConfig config;
+	int totalNodes;  // only changed by extend()
+	const NodeFilterType filterType;
+	std::vector<unsigned char> removedNodes;  // removedNodes[n] is 1 while n is removed, stays empty until the first removal
+
+	CSRGraph graph;							 // used to represent the graph, built by build() or mapped by loadSnapshot(), only extend() appends rows
+	std::vector<unsigned int> ownedOffsets;	 // the arrays of a graph that was built, a mapped graph points into the snapshot instead
+	std::vector<int> ownedTargets;
+	MappedFile snapshot;
+	std::unique_ptr<NodeFilterBank> nodeFilters;  // filter n holds every factor of n, 1 and n itself, all filters share one buffer
+	ShardedFalsePositiveCache falsePositiveCache;	// caches the results that turned out to be false +ve, safe to share between threads
+	PrimeLabelIndex labelIndex;						// empty until labelNodes()
+	QueryStats queryStats;							// only counts while config.queryStats is set
+	BuildTimings timings;
+
+	// scratch space of the pruned DFS, one per thread so that concurrent queries never share it
+	// visitedInQuery[n] == currentQuery means that node n was already pushed by the running query
+	// so starting a new query is just incrementing currentQuery and the visited array never has to be cleared
+	struct DFSScratch {
+		std::vector<unsigned int> visitedInQuery;
+		unsigned int currentQuery = 0;
+		std::vector<int> dfsStack;
+	};
+
+	static bloom_parameters nodeFilterParameters(const double falsePositivityRateInPC) {
+		bloom_parameters parameters;
+		parameters.false_positive_probability = falsePositivityRateInPC / 100;
+		parameters.hash_scheme = double_hashing_mix64;	// keys are ints, one 64 bit mix per query instead of one AP hash per hash function
+		parameters.index_scheme = fastrange_index;		// a multiply and a shift per probe instead of a division, the filters keep their size
+		return parameters;
+	}
+
+	static std::unique_ptr<NodeFilterBank> createNodeFilters(const GraphConfig &config) {
+		const double falsePositiveProbability = config.falsePositivityRateInPC / 100;
+		std::unique_ptr<NodeFilterBank> filters;
+		if (config.filterType == CUCKOO_FILTER) filters = std::make_unique<CuckooFilterBank>(falsePositiveProbability);
+		else if (config.filterType == BINARY_FUSE_FILTER) filters = std::make_unique<BinaryFuseFilterBank>(falsePositiveProbability);
+		else filters = std::make_unique<BloomFilterBank>(nodeFilterParameters(config.falsePositivityRateInPC), (bloom_filter_layout)config.filterType);
+		if (config.exactSmallNodes) return std::make_unique<ExactSetFilterBank>(std::move(filters));
+		return filters;
+	}
+
+	// reserves the filter of the next node in the bank, size is the max number of elements the filter can contain
+	// a bloom filter bank computes the optimal parameters only once for every distinct size and shares the salts between filters
+	NodeFilterBank::FilterId createBloomFilter(const int size) { return nodeFilters->add(size); }
+
+	// builds the filter of every node in [firstNode, lastNode] from the factors in its row that were not removed, 1 and the node itself
+	// the row of node n is factorLists[n - firstRow]
+	void fillNodeFilters(const std::vector<std::vector<int>> &factorLists, const int firstRow, const int firstNode, const int lastNode) {
+		std::vector<int> keys;	// reused by every node of the chunk
+		for (int i = firstNode; i <= lastNode; i++) {
+			keys.clear();
+			for (const int &factor: factorLists[i - firstRow])
+				if (not isRemoved(factor)) keys.push_back(factor);	// a removed node stays out of the filters of its new multiples too
+			keys.push_back(1);	// inserting 1
+			keys.push_back(i);	// inserting the number itself
+			nodeFilters->build(i, keys.data(), keys.size());
+		}
+	}
+
+	bool updatable(const int node) const { return filterType == COUNTING_BLOOM_FILTER and snapshot.data() == nullptr and node >= 2 and node <= totalNodes; }
+
+	// every node reachable from node in the compressed graph, 1 and node itself, in no particular order
+	std::vector<int> factorsOf(const int node) const {
+		std::vector<int> factors = {1, node}, dfsStack = {node};
+		while (not dfsStack.empty()) {
+			const int currentNode = dfsStack.back();
+			dfsStack.pop_back();
+			for (const int *factor = graph.neighboursBegin(currentNode); factor != graph.neighboursEnd(currentNode); factor++)
+				if (std::find(factors.begin(), factors.end(), *factor) == factors.end()) {	// a number has at most a few thousand factors
+					factors.push_back(*factor);
+					dfsStack.push_back(*factor);
+				}
+		}
+		return factors;
+	}
+
+	// sieve of factors: instead of trial dividing every i by every j < i, every factor d is pushed into its multiples 2d, 3d, ...
+	// only the multiples that lie inside [firstNode, lastNode] are visited so that every worker owns a disjoint range of rows
+	// the row of node n is factorLists[n - firstRow], so extend() only needs rows for the new nodes
+	// the sieve still steps through every factor up to lastNode / 2, so a chunk of a few rows far from 2(as extend() grows the graph by a
+	// few nodes) trial divides every row up to its square root instead, which costs time proportional to the rows and not to lastNode
+	static void collectFactors(std::vector<std::vector<int>> &factorLists, const int firstNode, const int lastNode, const int firstRow = 0) {
+		if ((long long)(lastNode - firstNode + 1) * (long long)std::sqrt((double)lastNode) < lastNode / 2) {
+			for (int node = firstNode; node <= lastNode; node++) collectFactorsByTrialDivision(node, factorLists[node - firstRow]);
+			return;
+		}
+		for (int factor = 2; factor <= lastNode / 2; factor++) {
+			const int firstMultiple = std::max(2 * factor, (firstNode + factor - 1) / factor * factor);	 // smallest multiple of factor in the chunk
+			for (int multiple = firstMultiple; multiple <= lastNode; multiple += factor)
+				factorLists[multiple - firstRow].push_back(factor);	 // factors are visited in ascending order so every row stays sorted
+		}
+	}
+
+	// every factor of node other than 1 and node in ascending order: d below the square root in order, node / d above it in reverse
+	static void collectFactorsByTrialDivision(const int node, std::vector<int> &factors) {
+		int factor = 2;
+		for (; (long long)factor * factor < node; factor++)
+			if (node % factor == 0) factors.push_back(factor);
+		const std::size_t belowRoot = factors.size();
+		if ((long long)factor * factor == node) factors.push_back(factor);
+		for (std::size_t i = belowRoot; i-- > 0;) factors.push_back(node / factors[i]);
+	}
+
+	// sieve of eratosthenes that remembers which prime crossed out a number first
+	std::vector<int> buildSmallestPrimeFactors() const {
+		std::vector<int> smallestPrimeFactor(totalNodes + 1, 0);
+		for (int i = 2; i <= totalNodes; i++) {
+			if (smallestPrimeFactor[i] != 0) continue;	// i was crossed out already, so it is not a prime
+			for (int multiple = i; multiple <= totalNodes; multiple += i)
+				if (smallestPrimeFactor[multiple] == 0) smallestPrimeFactor[multiple] = i;
+		}
+		return smallestPrimeFactor;
+	}
+
+	// transitive reduction of the divisor graph: every factor of n is reachable through n/p for some prime p that divides n
+	// so those are the only edges that have to be kept, eg 12 keeps 6(12/2) and 4(12/3) while 2 and 3 are reachable through them
+	// the kept edges are written over the factor list itself which is at least as long, so compressing a row never allocates
+	static void compressFactors(const int node, std::vector<int> &factors, const std::vector<int> &smallestPrimeFactor) {
+		int totalKept = 0;
+		for (int remaining = node; remaining > 1;) {
+			const int prime = smallestPrimeFactor[remaining];
+			while (remaining % prime == 0) remaining /= prime;
+			if (node != prime) factors[totalKept++] = node / prime;	 // primes have no factors, node / prime would have been 1
+		}
+		std::reverse(factors.begin(), factors.begin() + totalKept);	 // primes are found in ascending order, so node / prime was found in descending order
+		factors.resize(totalKept);									 // shrinking a vector never reallocates
+	}
+
+	// same edges as compressFactors() without sieving every number up to node, which extend() cant afford for a few new nodes
+	// the smallest factor of node that still divides what is left of node is always a prime, so the sorted row factorizes node on its own
+	static void compressFactorsOfRow(const int node, std::vector<int> &factors) {
+		int primes[10], totalPrimes = 0;  // a 32 bit int has at most 9 distinct prime factors, primes have an empty row and none here
+		int remaining = node;
+		for (const int factor: factors)
+			if (remaining % factor == 0) {
+				primes[totalPrimes++] = factor;
+				while (remaining % factor == 0) remaining /= factor;
+			}
+
+		for (int i = 0; i < totalPrimes; i++) factors[i] = node / primes[totalPrimes - 1 - i];	// ascending, like compressFactors()
+		factors.resize(totalPrimes);
+	}
+
+	// appends the rows of [firstNode, lastNode] to a buffer sized for the worst case up front, so formatting never reallocates
+	void formatNodes(const int firstNode, const int lastNode, const GraphFormat format, std::vector<char> &buffer) const {
+		const std::size_t edges = graph.offsets[lastNode + 1] - graph.offsets[firstNode];
+		buffer.resize((std::size_t)(lastNode - firstNode + 1) * 48 + edges * 32);  // a row needs at most 36 characters and an edge at most 30
+
+		char *end = buffer.data();
+		const auto append = [&](const char *text) {
+			const std::size_t length = std::strlen(text);
+			std::memcpy(end, text, length);
+			end += length;
+		};
+		const auto appendNumber = [&](const int number) { end = std::to_chars(end, end + 11, number).ptr; };
+
+		for (int i = firstNode; i <= lastNode; i++) {
+			const int *factor = graph.neighboursBegin(i), *last = graph.neighboursEnd(i);
+			if (format == TEXT_FORMAT) {
+				append("Factors of ");
+				appendNumber(i);
+				append(" : ");
+				for (; factor != last; factor++) appendNumber(*factor), append(" ");
+				append("\n");
+			} else if (format == EDGE_LIST_FORMAT) {
+				for (; factor != last; factor++) appendNumber(i), append(" "), appendNumber(*factor), append("\n");
+			} else {
+				if (factor == last) append("  "), appendNumber(i), append(";\n");
+				for (; factor != last; factor++) append("  "), appendNumber(i), append(" -> "), appendNumber(*factor), append(";\n");
+			}
+		}
+		buffer.resize(end - buffer.data());
+	}
+
+	// packs the compressed rows into one offsets array and one targets array
+	void packIntoCSR(const std::vector<std::vector<int>> &compressedLists) {
+		ownedOffsets.assign(compressedLists.size() + 1, 0);
+		for (std::size_t i = 0; i < compressedLists.size(); i++) ownedOffsets[i + 1] = ownedOffsets[i] + compressedLists[i].size();
+
+		ownedTargets.clear();
+		ownedTargets.reserve(ownedOffsets.back());	// exactly one allocation for all the edges
+		for (const std::vector<int> &row: compressedLists) ownedTargets.insert(ownedTargets.end(), row.cbegin(), row.cend());
+
+		graph.offsets = ownedOffsets.data(), graph.targets = ownedTargets.data();
+		graph.rowCount = compressedLists.size();
+	}
+
+	// appends compressed rows for the nodes after the last row, the vectors grow geometrically so the old rows are copied O(1) times on average
+	void appendToCSR(const std::vector<std::vector<int>> &compressedLists) {
+		for (const std::vector<int> &row: compressedLists) {
+			ownedTargets.insert(ownedTargets.end(), row.cbegin(), row.cend());
+			ownedOffsets.push_back(ownedTargets.size());
+		}
+
+		graph.offsets = ownedOffsets.data(), graph.targets = ownedTargets.data();
+		graph.rowCount += compressedLists.size();
+	}
+
+	struct SnapshotHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t filterType;
+		int64_t totalNodes;
+		double falsePositivityRateInPC;
+		uint64_t edgeCount;
+		uint64_t bankBytes;
+	};
+	static constexpr const char *SNAPSHOT_MAGIC = "DFSBLOOM";
+	static constexpr uint32_t SNAPSHOT_VERSION = 3;	 // bump whenever the layout of the graph or of the filter bank changes
+
+	static std::size_t snapshotAlign(const std::size_t bytes) { return (bytes + 63) / 64 * 64; }
+
+	// the rows of a mapped graph are only read if the offsets ascend from 0 to edgeCount and every target is a smaller node
+	// (the compressed row of n holds n / p for the primes p of n), so the DFS never leaves the targets or the visited array
+	bool validSnapshotRows(const unsigned int *offsets, const int *targets, const uint64_t edgeCount) const {
+		if (offsets[0] != 0 or offsets[totalNodes + 1] != edgeCount) return false;
+		for (int node = 0; node <= totalNodes; node++) {
+			if (offsets[node] > offsets[node + 1]) return false;
+			for (unsigned int edge = offsets[node]; edge < offsets[node + 1]; edge++)
+				if (targets[edge] < 1 or targets[edge] >= node) return false;
+		}
+		return true;
+	}
+	static void writeSnapshotSection(std::ostream &out, const void *data, const std::size_t bytes) {
+		static const char padding[64] = {};
+		out.write((const char *)data, bytes);
+		out.write(padding, snapshotAlign(bytes) - bytes);
+	}
+
+	void cacheFalsePositiveResult(const int isThisNumber, const int aFactorOfThisNumber) { falsePositiveCache.insert(isThisNumber, aFactorOfThisNumber); }
+
+	// a hit marks the entry as recently used so that the least queried items(one hit wonders) are evicted first once the cache is full
+	bool inCache(const int isThisNumber, const int aFactorOfThisNumber) { return falsePositiveCache.contains(isThisNumber, aFactorOfThisNumber); }
+
+	bool searchUsingBaselineDFS(const int isThisNumber, const int aFactorOfThisNumber) const {
+		std::stack<int> dfsStack;
+		dfsStack.push(aFactorOfThisNumber);
+
+		while (not dfsStack.empty()) {
+			const int currentNode = dfsStack.top();
+			if (currentNode == isThisNumber) return true;
+			dfsStack.pop();
+			for (const int *factor = graph.neighboursBegin(currentNode); factor != graph.neighboursEnd(currentNode); factor++) dfsStack.push(*factor);
+		}
+
+		return false;
+	}
+
+	// every node reachable from a node is one of its factors, so a node smaller than isThisNumber can never lead to it
+	// the scratch space is shared by every graph of the thread, a stamp of an earlier query never equals the current one whichever graph set it
+	// the filter of a node holds every factor of the node, which is everything reachable from it, so withFilters skips the whole subtree
+	// below a node whose filter rules out isThisNumber, and stops at a node whose exact set has it
+	// removed nodes had their filter cleared but still lead to their factors, so they are always expanded
+	bool searchUsingPrunedDFS(const int isThisNumber, const int aFactorOfThisNumber, const bool withFilters) const {
+		static thread_local DFSScratch scratch;
+		if (scratch.visitedInQuery.size() < graph.rowCount) scratch.visitedInQuery.resize(graph.rowCount, 0);
+		if (++scratch.currentQuery == 0) {	// wrapped around after 2^32 queries, only now the array has to be cleared
+			std::fill(scratch.visitedInQuery.begin(), scratch.visitedInQuery.end(), 0);
+			scratch.currentQuery = 1;
+		}
+
+		std::vector<int> &dfsStack = scratch.dfsStack;
+		dfsStack.clear();
+		if (aFactorOfThisNumber < isThisNumber) return false;
+		dfsStack.push_back(aFactorOfThisNumber);
+		scratch.visitedInQuery[aFactorOfThisNumber] = scratch.currentQuery;
+
+		uint64_t expanded = 0;	// counted locally and added to the stats once, the loop stays free of atomics
+		while (not dfsStack.empty()) {
+			const int currentNode = dfsStack.back();
+			if (currentNode == isThisNumber) return queryStats.count(DFS_NODES_EXPANDED, expanded), true;
+			dfsStack.pop_back();
+			expanded++;
+			for (const int *factor = graph.neighboursBegin(currentNode); factor != graph.neighboursEnd(currentNode); factor++)
+				if (*factor >= isThisNumber and scratch.visitedInQuery[*factor] != scratch.currentQuery) {
+					scratch.visitedInQuery[*factor] = scratch.currentQuery;
+					if (withFilters and not isRemoved(*factor)) {
+						if (not nodeFilters->contains(*factor, isThisNumber)) continue;
+						if (nodeFilters->exact(*factor)) return queryStats.count(DFS_NODES_EXPANDED, expanded), true;
+					}
+					dfsStack.push_back(*factor);
+				}
+		}
+
+		queryStats.count(DFS_NODES_EXPANDED, expanded);
+		return false;
+	}
+
+	// the bloom filter said probable true which could be a false positive, so check the cache that maintains previous false positive results
+	// and if it is not cached let the DFS decide
+	// PRUNED_DFS rather than FILTER_PRUNED_DFS: it only expands a few nodes >= isThisNumber, so a filter query per node costs more than it saves
+	// every probable factor ends here, so this is where the filters are caught being wrong
+	bool confirmProbableFactor(const int isThisNumber, const int aFactorOfThisNumber) {
+		const auto cacheStart = queryStats.start();
+		const bool cached = inCache(isThisNumber, aFactorOfThisNumber);
+		queryStats.finish(CACHE_STAGE, cacheStart);
+		if (cached) {
+			queryStats.count(CACHE_HITS), queryStats.count(FALSE_POSITIVES);
+			return false;
+		}
+
+		queryStats.count(DFS_FALLBACKS);
+		const auto dfsStart = queryStats.start();
+		const bool result = searchUsingDFS(isThisNumber, aFactorOfThisNumber);
+		queryStats.finish(DFS_STAGE, dfsStart);
+		queryStats.count(result ? TRUE_POSITIVES : FALSE_POSITIVES);
+		if (result == false) cacheFalsePositiveResult(isThisNumber, aFactorOfThisNumber);
+		return result;
+	}
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef INCLUDE_FALSE_POSITIVE_CACHE_HPP
+#define INCLUDE_FALSE_POSITIVE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// caches the (isThisNumber, aFactorOfThisNumber) pairs that the bloom filters reported as probable true but turned out to be false +ve
+// both numbers are packed into one 64 bit key, the keys live in a fixed array of capacity entries and are found through an open
+// addressed index with linear probing, so a lookup hashes once and reads a few neighbouring slots no matter how large the cache is
+// when the cache is full the CLOCK algorithm picks the entry to evict: every hit sets the referenced bit of the entry and the clock
+// hand sweeps over the entries clearing referenced bits until it finds one that was not hit since the last sweep
+// this approximates LRU(one hit wonders are evicted first) while both lookups and insertions stay O(1)
+class FalsePositiveCache {
+   public:
+	explicit FalsePositiveCache(const int capacity = 0) { resize(capacity); }
+
+	// drops every cached entry, capacity <= 0 disables the cache
+	void resize(const int capacity) {
+		entries.assign(capacity > 0 ? capacity : 0, Entry());
+		entryCount = clockHand = 0;
+
+		int indexLen = 1;
+		while (indexLen < 2 * (int)entries.size()) indexLen *= 2;  // power of two with a load factor of at most 1/2
+		index.assign(indexLen, EMPTY_SLOT);
+		indexShift = 64;
+		for (int len = indexLen; len > 1; len /= 2) indexShift--;
+	}
+
+	bool contains(const int isThisNumber, const int aFactorOfThisNumber) {
+		const int slot = findSlot(packKey(isThisNumber, aFactorOfThisNumber));
+		if (index[slot] == EMPTY_SLOT) return false;
+		entries[index[slot]].referenced = true;	 // hit, so the clock hand will spare it once
+		return true;
+	}
+
+	void insert(const int isThisNumber, const int aFactorOfThisNumber) {
+		if (entries.empty()) return;
+		const uint64_t key = packKey(isThisNumber, aFactorOfThisNumber);
+		const int slot = findSlot(key);
+		if (index[slot] != EMPTY_SLOT) return;	// already cached
+
+		int entry = entryCount, freeSlot = slot;
+		if (entryCount < (int)entries.size()) entryCount++;
+		else {
+			entry = evictOne();
+			freeSlot = findSlot(key);  // evicting shifts slots around, so the free slot has to be found again
+		}
+		entries[entry] = Entry{key, false};
+		index[freeSlot] = entry;
+	}
+
+	// forgets a cached result that is no longer false, eg because the graph changed, returns false if it was not cached
+	bool erase(const int isThisNumber, const int aFactorOfThisNumber) {
+		if (entries.empty()) return false;
+		const int slot = findSlot(packKey(isThisNumber, aFactorOfThisNumber));
+		if (index[slot] == EMPTY_SLOT) return false;
+
+		const int entry = index[slot];
+		unlinkSlot(slot);
+		entryCount--;
+		if (entry != entryCount) {	// keep the entries in use contiguous by moving the last one into the gap
+			index[findSlot(entries[entryCount].key)] = entry;
+			entries[entry] = entries[entryCount];
+		}
+		if (clockHand >= entryCount) clockHand = 0;
+		return true;
+	}
+
+	int size() const { return entryCount; }
+	int capacity() const { return entries.size(); }
+	std::size_t memoryUsage() const { return entries.capacity() * sizeof(Entry) + index.capacity() * sizeof(int); }
+
+   private:
+	struct Entry {
+		uint64_t key = 0;
+		bool referenced = false;
+	};
+	static constexpr int EMPTY_SLOT = -1;
+
+	std::vector<Entry> entries;	 // the cached keys, entries[0 .. entryCount - 1] are in use
+	std::vector<int> index;		 // open addressed hash index holding positions in entries
+	int entryCount = 0, clockHand = 0, indexShift = 64;
+
+	static uint64_t packKey(const int isThisNumber, const int aFactorOfThisNumber) { return (uint64_t)(uint32_t)isThisNumber << 32 | (uint32_t)aFactorOfThisNumber; }
+	int homeSlot(const uint64_t key) const { return indexShift == 64 ? 0 : (key * 0x9E3779B97F4A7C15ULL) >> indexShift; }	// fibonacci hashing
+	int nextSlot(const int slot) const { return (slot + 1) & (index.size() - 1); }
+
+	// returns the slot holding key, or the empty slot where key would be inserted
+	int findSlot(const uint64_t key) const {
+		int slot = homeSlot(key);
+		while (index[slot] != EMPTY_SLOT and entries[index[slot]].key != key) slot = nextSlot(slot);
+		return slot;
+	}
+
+	// advances the clock hand to the first entry that was not referenced since the last sweep, unlinks it from the index and returns it
+	int evictOne() {
+		while (entries[clockHand].referenced) {
+			entries[clockHand].referenced = false;
+			clockHand = (clockHand + 1) % entries.size();
+		}
+		const int victim = clockHand;
+		clockHand = (clockHand + 1) % entries.size();
+		unlinkSlot(findSlot(entries[victim].key));
+		return victim;
+	}
+
+	// backward shift deletion: pull later slots of the probe sequence into the hole so that no lookup stops early at it
+	void unlinkSlot(int hole) {
+		for (int slot = nextSlot(hole); index[slot] != EMPTY_SLOT; slot = nextSlot(slot)) {
+			const int home = homeSlot(entries[index[slot]].key);
+			const bool canMoveIntoHole = hole <= slot ? (home <= hole or home > slot) : (home <= hole and home > slot);
+			if (canMoveIntoHole) {
+				index[hole] = index[slot];
+				hole = slot;
+			}
+		}
+		index[hole] = EMPTY_SLOT;
+	}
+};
+
+// FalsePositiveCache split into independently locked shards so that many threads can look up and cache false +ve at the same time
+// the shard of a key is picked by a hash that is independent of the one used inside the shard, so keys spread evenly over the shards
+// and threads only wait for each other when they happen to touch the same shard
+class ShardedFalsePositiveCache {
+   public:
+	explicit ShardedFalsePositiveCache(const int capacity = 0, const int shardCount = 64) : shardCount(shardCount), shards(new Shard[shardCount]) { resize(capacity); }
+
+	// drops every cached entry, the capacity is split evenly between the shards
+	void resize(const int capacity) {
+		const int shardCapacity = capacity > 0 ? (capacity + shardCount - 1) / shardCount : 0;
+		for (int i = 0; i < shardCount; i++) {
+			std::lock_guard<std::mutex> guard(shards[i].lock);
+			shards[i].cache.resize(shardCapacity);
+		}
+	}
+
+	bool contains(const int isThisNumber, const int aFactorOfThisNumber) {
+		Shard &shard = shardOf(isThisNumber, aFactorOfThisNumber);
+		std::lock_guard<std::mutex> guard(shard.lock);	// a hit updates the referenced bit, so lookups lock too
+		return shard.cache.contains(isThisNumber, aFactorOfThisNumber);
+	}
+
+	void insert(const int isThisNumber, const int aFactorOfThisNumber) {
+		Shard &shard = shardOf(isThisNumber, aFactorOfThisNumber);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		shard.cache.insert(isThisNumber, aFactorOfThisNumber);
+	}
+
+	bool erase(const int isThisNumber, const int aFactorOfThisNumber) {
+		Shard &shard = shardOf(isThisNumber, aFactorOfThisNumber);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		return shard.cache.erase(isThisNumber, aFactorOfThisNumber);
+	}
+
+	int size() const { return sumOverShards(&FalsePositiveCache::size); }
+	int capacity() const { return sumOverShards(&FalsePositiveCache::capacity); }
+	std::size_t memoryUsage() const {
+		std::size_t total = shardCount * sizeof(Shard);
+		for (int i = 0; i < shardCount; i++) {
+			std::lock_guard<std::mutex> guard(shards[i].lock);
+			total += shards[i].cache.memoryUsage();
+		}
+		return total;
+	}
+
+   private:
+	struct alignas(64) Shard {	// one cache line per lock so that threads spinning on neighbouring shards dont share a line
+		mutable std::mutex lock;
+		FalsePositiveCache cache;
+	};
+
+	const int shardCount;
+	std::unique_ptr<Shard[]> shards;
+
+	Shard &shardOf(const int isThisNumber, const int aFactorOfThisNumber) {
+		uint64_t key = (uint64_t)(uint32_t)isThisNumber << 32 | (uint32_t)aFactorOfThisNumber;
+		key = (key ^ (key >> 31)) * 0xBF58476D1CE4E5B9ULL;	// splitmix64 step, unrelated to the fibonacci hashing inside a shard
+		return shards[(key ^ (key >> 29)) % shardCount];
+	}
+
+	int sumOverShards(int (FalsePositiveCache::*count)() const) const {
+		int total = 0;
+		for (int i = 0; i < shardCount; i++) {
+			std::lock_guard<std::mutex> guard(shards[i].lock);
+			total += (shards[i].cache.*count)();
+		}
+		return total;
+	}
+};
+
+#endif
@@ -1,149 +1,358 @@
-#include <forward_list>	 // singly linked list for caching false +ve results from bloom filter
+#include <charconv>	 // to_chars for writing batch results
+#include <chrono>	 // used to time graph construction and queries
+#include <cstdio>	 // FILE streams for batch mode
+#include <cstring>
+#include <fstream>  // config files
 #include <iostream>
-#include <set>	  // used to check memberships while compressing graph
-#include <stack>  // used for DFS
+#include <memory>
+#include <random>  // random queries for measuring throughput
+#include <sstream>
+#include <thread>
 
-#include "bloom_filter.hpp"
+#include "divisor_graph.hpp"	// the graph, its bloom filters and the false +ve cache
+#include "query_benchmark.hpp"	// query workloads and latency percentiles shared with bench.cpp
 using namespace std;
 
-const bool PRINT_GRAPH = true;
-const int TOTAL_NODES = 20001;													// total nodes in the entire graph
-const int FALSE_POSITIVITY_RATE_IN_PC = 1;										// cache wont have more than 1% of TOTAL_NODES
-const int CACHE_LEN_LIMIT = (FALSE_POSITIVITY_RATE_IN_PC / 100) * TOTAL_NODES;	// hence the false +ve probability is also 1%
-
-vector<pair<vector<int>, bloom_filter>> adjacencyList;	// used to represent the graph
-forward_list<string> falsePositiveCache;				// caches the results that turned out to be false +ve
-
-bloom_filter createBloomFilter(const int size) {
-	bloom_parameters parameters;
-	parameters.projected_element_count = size;	// max number of elements the bloom filter can contain
-	parameters.false_positive_probability = (float)FALSE_POSITIVITY_RATE_IN_PC / 100;
-	parameters.compute_optimal_parameters();
-	bloom_filter bf(parameters);
-	return bf;
+// how --batch answers the queries
+enum SearchMethod { DFS_SEARCH, BLOOM_FILTER_SEARCH, LABEL_SEARCH };
+
+const char *searchMethodName(const SearchMethod method) {
+	return method == DFS_SEARCH ? "DFS" : method == BLOOM_FILTER_SEARCH ? "DFS+Caching+BloomFilter" : "Prime Label Index";
 }
-void GraphBuilder() {
-	adjacencyList.resize(TOTAL_NODES + 1);	// to avoid Amortized O(1) insertions
-
-	// Building the adjacency list for uncompressed graph
-	for (int i = 2; i <= TOTAL_NODES; i++) {
-		adjacencyList[i].second = bloom_filter();  // creating an empty bloom filter as the number of factors to be inserted in the bloom filter is unknown
-		for (int j = 2; j < i; j++)
-			if (i % j == 0) adjacencyList[i].first.push_back(j);  // append factor to adjacency list
-	}
 
-	// factors for all elements have been found, so we know exactly how many factors does a number have
-	// setting up bloom filters from uncompressed graph with size=number of factors of that number
-	for (int i = 2; i <= TOTAL_NODES; i++) {
-		const vector<int> &factors = adjacencyList[i].first;					  // retreive all factors of that number in an array
-		adjacencyList[i].second = createBloomFilter(factors.size() + 2);		  // create bloom filter that can hold all these numbers, 1 and the number itself
-		for (const int &factor: factors) adjacencyList[i].second.insert(factor);  // insert all factors for i inside the bloom filter
-		adjacencyList[i].second.insert(1);										  // inserting 1
-		adjacencyList[i].second.insert(i);										  // inserting the number itself
-	}
+// every graph is configured at runtime through the command line or a config file, see printUsage()
+bool printGraphAfterBuild = true;
+GraphFormat printFormat = TEXT_FORMAT;
+string exportPath;	// the queried graph is written to this file in printFormat instead of being printed
+string snapshotPath;  // the queried graph is mapped from this snapshot if it matches the configuration, else it is built and saved there
+string statsPath;	  // the query statistics of the queried graph are written to this file after --batch
+vector<unique_ptr<DivisorGraph>> divisorGraphs;	 // divisorGraphs[0] answers every query, the others are only built to be compared with it
 
-	// Compressing the graph inplace
-	for (int i = TOTAL_NODES; i >= 2; i--) {
-		vector<int> &listToBeCompressed = adjacencyList[i].first;	// compress adjacency list row by row, from bottom up
-		for (int j = listToBeCompressed.size() - 1; j >= 0; j--) {	// read the row(sorted in Ascending Order) backwards
-			int largerNumber = listToBeCompressed[j];
-			set<int> factorsOfTheLargerNumber(adjacencyList[largerNumber].first.cbegin(), adjacencyList[largerNumber].first.cend());
+DivisorGraph &queriedGraph() { return *divisorGraphs.front(); }
+int totalNodes() { return queriedGraph().nodeCount(); }
 
-			for (int k = listToBeCompressed.size() - 1; k >= 0; k--)
-				if (factorsOfTheLargerNumber.count(listToBeCompressed[k]))
-					listToBeCompressed.erase(listToBeCompressed.cbegin() + k);	// Removes the common factors
-		}
+string describe(const GraphConfig &config) {
+	stringstream description;
+	description << config.totalNodes << " nodes, " << config.falsePositivityRateInPC << "% false +ve, " << config.cacheCapacity() << " cache entries, "
+				<< filterTypeName(config.filterType) << (isBloomFilter(config.filterType) ? " bloom filters" : " filters")
+				<< (config.exactSmallNodes ? " or exact sets" : "");
+	return description.str();
+}
+
+void GraphBuilder(DivisorGraph &divisorGraph, const bool printGraph, const string &snapshot = "") {
+	using namespace std::chrono;
+	const auto loadStart = steady_clock::now();
+	if (not snapshot.empty() and divisorGraph.loadSnapshot(snapshot)) {
+		const auto loadTime = duration<double, milli>(steady_clock::now() - loadStart);
+		cout << "GRAPH OF " << describe(divisorGraph.configuration()) << " HAS BEEN MAPPED FROM " << snapshot << " IN " << loadTime.count() << " Milliseconds!" << endl;
+	} else {
+		cout << "Please wait while the graph of " << describe(divisorGraph.configuration()) << " is being generated, this might take a while..." << endl;
+		const auto buildTime = duration_cast<milliseconds>(divisorGraph.build());
+		cout << "GRAPH HAS BEEN BUILT IN " << buildTime.count() << " Milliseconds USING " << workerCount() << " THREADS!" << endl;
+		const BuildTimings &timings = divisorGraph.buildTimings();
+		cout << "Factorizing: " << duration_cast<milliseconds>(timings.factor).count() << " Milliseconds, Filling the filters: "
+			 << duration_cast<milliseconds>(timings.filter).count() << " Milliseconds, Compressing: " << duration_cast<milliseconds>(timings.compress).count()
+			 << " Milliseconds" << endl;
+		if (not snapshot.empty()) cout << (divisorGraph.saveSnapshot(snapshot) ? "Saved the graph to " : "Could not save the graph to ") << snapshot << endl;
 	}
 
-	cout << "GRAPH HAS BEEN BUILT!" << endl;
-	if (not PRINT_GRAPH) return;
+	cout << "Graph: " << divisorGraph.compressedGraph().edgeCount() << " edges in " << divisorGraph.compressedGraph().memoryUsage()
+		 << " Bytes, " << divisorGraph.filters().name() << ": " << divisorGraph.filters().memoryUsage() << " Bytes" << endl;
+	divisorGraph.reportFilterAccuracy(cout);
+	if (not printGraph) return;
 
 	// Printing the compressed graph
-	for (int i = 2; i <= TOTAL_NODES; i++) {
-		cout << "Factors of " << i << " : ";
-		for (const int &factor: adjacencyList[i].first) cout << factor << " ";
-		cout << "\n";
+	if (exportPath.empty()) {
+		divisorGraph.printGraph(cout, printFormat);
+		return;
 	}
+	ofstream exportFile(exportPath, ios::binary);
+	divisorGraph.printGraph(exportFile, printFormat);
+	cout << (exportFile ? "Exported the graph to " : "Could not export the graph to ") << exportPath << endl;
 }
 
-string generateKey(const int isThisNumber, const int aFactorOfThisNumber) { return to_string(isThisNumber) + ',' + to_string(aFactorOfThisNumber); }
+bool searchUsingDFS(const int isThisNumber, const int aFactorOfThisNumber, const DFSMode mode = PRUNED_DFS) { return queriedGraph().searchUsingDFS(isThisNumber, aFactorOfThisNumber, mode); }
+bool searchUsingBloomFilter(const int isThisNumber, const int aFactorOfThisNumber) { return queriedGraph().searchUsingBloomFilter(isThisNumber, aFactorOfThisNumber); }
+bool searchUsingLabels(const int isThisNumber, const int aFactorOfThisNumber) { return queriedGraph().searchUsingLabels(isThisNumber, aFactorOfThisNumber); }
+
+// the label index is only built the first time it is queried
+void labelGraph() {
+	DivisorGraph &divisorGraph = queriedGraph();
+	if (divisorGraph.labelled()) return;
+	const auto labelTime = chrono::duration<double, milli>(divisorGraph.labelNodes()).count();
+	cout << "LABELLED " << totalNodes() << " NODES WITH THEIR PRIME POWERS IN " << labelTime << " Milliseconds, " << divisorGraph.labels().memoryUsage() << " Bytes" << endl;
+}
 
-void pruneCache() {
-	const int cacheLen = abs(distance(falsePositiveCache.cbegin(), falsePositiveCache.cend()));
-	if (cacheLen > CACHE_LEN_LIMIT) {
-		auto pruningPtr = next(falsePositiveCache.cbegin(), cacheLen - 1);
-		falsePositiveCache.erase_after(pruningPtr);	 // deletes excess nodes after CACHE_LEN_LIMIT nodes
+// writes the counters of the queried graph to path, or to the screen if path is -
+bool exportStats(const string &path, const StatsFormat format) {
+	if (path == "-") {
+		queriedGraph().writeStats(cout, format);
+		return true;
 	}
+	ofstream file(path);
+	queriedGraph().writeStats(file, format);
+	return bool(file);
+}
+
+// answers the same random workload with every search after warming the cache up, bench.cpp runs the full sweep of sizes and workloads
+void compareExecTime() {
+	const vector<Query> queries = generateQueries(UNIFORM_QUERIES, totalNodes(), 10000);
+	const auto report = [](const char *name, const LatencySummary &summary) {
+		cout << name << " took: " << summary.p50Ns << " / " << summary.p99Ns << " / " << summary.p999Ns << " Nanoseconds at p50 / p99 / p999, "
+			 << (long long)summary.queriesPerSecond << " Queries/Second" << endl;
+	};
+
+	report("Baseline DFS", measureLatency(queries, 1, 3, [](const int x, const int y) { return searchUsingDFS(x, y, BASELINE_DFS); }));
+	report("DFS", measureLatency(queries, 1, 3, [](const int x, const int y) { return searchUsingDFS(x, y, PRUNED_DFS); }));
+	report("Filter Pruned DFS", measureLatency(queries, 1, 3, [](const int x, const int y) { return searchUsingDFS(x, y, FILTER_PRUNED_DFS); }));
+	report("DFS + Bloom Filter with False+ve Caching", measureLatency(queries, 1, 3, searchUsingBloomFilter));
+	labelGraph();
+	report("Prime Label Index", measureLatency(queries, 1, 3, searchUsingLabels));
 }
-void cacheFalsePositiveResult(const int isThisNumber, const int aFactorOfThisNumber) {
-	falsePositiveCache.push_front(generateKey(isThisNumber, aFactorOfThisNumber));
-	pruneCache();
+
+// every thread answers the same number of random queries using the bloom filter, first on 1 thread then 2, 4 ... up to all the cores
+// the threads share the graph, the filters and the false +ve cache exactly like concurrent callers of searchUsingBloomFilter would
+void measureQueryThroughput() {
+	using namespace std::chrono;
+	const int queriesPerThread = 1000000;
+
+	for (int totalThreads = 1;; totalThreads = min(2 * totalThreads, workerCount())) {
+		vector<thread> workers;
+		const auto start = steady_clock::now();
+		for (int t = 0; t < totalThreads; t++)
+			workers.emplace_back([t] {
+				mt19937 rng(t);
+				uniform_int_distribution<int> node(2, totalNodes());
+				for (int q = 0; q < queriesPerThread; q++) {
+					const int y = node(rng);
+					searchUsingBloomFilter(uniform_int_distribution<int>(1, y)(rng), y);  // is a random number up to y a factor of y?
+				}
+			});
+		for (thread &worker: workers) worker.join();
+		const double seconds = duration<double>(steady_clock::now() - start).count();
+
+		cout << totalThreads << " Threads answered " << (long long)(totalThreads * queriesPerThread / seconds) << " Queries/Second" << endl;
+		if (totalThreads == workerCount()) break;
+	}
 }
-bool inCache(const int isThisNumber, const int aFactorOfThisNumber) {
-	for (const string &knownFalsePositive: falsePositiveCache)
-		if (const string key = generateKey(isThisNumber, aFactorOfThisNumber); key == knownFalsePositive) {
-			// if key in cache, move it to front so that response is faster next time
-			// this way least queried items(one hit wonders) are implicitly moved towards tailed and eventually gets pruned
-			falsePositiveCache.remove(key);
-			falsePositiveCache.push_front(key);
-			return true;
-		}
-	return false;
+
+// answers the same kind of random workload on every configured graph, so differently tuned graphs can be compared side by side
+void compareGraphs() {
+	for (const unique_ptr<DivisorGraph> &divisorGraph: divisorGraphs) {
+		const vector<Query> queries = generateQueries(UNIFORM_QUERIES, divisorGraph->nodeCount(), 100000);
+		const LatencySummary summary = measureLatency(queries, 1, 3, [&](const int x, const int y) { return divisorGraph->searchUsingBloomFilter(x, y); });
+		cout << describe(divisorGraph->configuration()) << ": " << divisorGraph->memoryUsage() << " Bytes, " << summary.p50Ns << " / " << summary.p99Ns
+			 << " Nanoseconds at p50 / p99, " << (long long)summary.queriesPerSecond << " Queries/Second" << endl;
+	}
 }
 
-bool searchUsingDFS(const int isThisNumber, const int aFactorOfThisNumber) {
-	if (isThisNumber == 1) return true;
-	stack<int> dfsStack;
-	dfsStack.push(aFactorOfThisNumber);
+// reads whitespace separated ints through a large buffer filled by fread, much faster than extracting them from an istream one by one
+class BufferedIntReader {
+   public:
+	explicit BufferedIntReader(FILE *input) : input(input), buffer(1 << 20) {}
+
+	bool readInt(int &value) {
+		int c = nextChar();
+		while (c != EOF and (c == ' ' or c == '\n' or c == '\r' or c == '\t')) c = nextChar();
+		if (c == EOF) return false;
+
+		const bool negative = c == '-';
+		if (negative) c = nextChar();
+		if (c < '0' or c > '9') return false;  // not a number, stop reading
+
+		long long parsed = 0;
+		for (; c >= '0' and c <= '9'; c = nextChar()) parsed = min(parsed * 10 + (c - '0'), (long long)INT32_MAX + 1);	// saturate instead of overflowing
+		value = negative ? -parsed : min(parsed, (long long)INT32_MAX);
+		return true;
+	}
+
+   private:
+	FILE *input;
+	vector<char> buffer;
+	size_t bufferPos = 0, bufferLen = 0;
+
+	int nextChar() {
+		if (bufferPos == bufferLen) {
+			bufferLen = fread(buffer.data(), 1, buffer.size(), input);
+			bufferPos = 0;
+			if (bufferLen == 0) return EOF;
+		}
+		return (unsigned char)buffer[bufferPos++];
+	}
+};
+
+// streams "x y" pairs from the input and writes one line per pair to stdout: 1 if x is a factor of y, 0 if it is not, -1 if out of range
+// pairs are read in large chunks, every chunk is answered by all the cores in parallel and its results are written with a single fwrite
+void answerBatch(FILE *input, const SearchMethod method) {
+	using namespace std::chrono;
+	const int chunkLen = 1 << 20;
+
+	BufferedIntReader reader(input);
+	vector<int> xs(chunkLen), ys(chunkLen);
+	vector<signed char> results(chunkLen);
+	vector<char> output(4 * chunkLen);
+	long long totalQueries = 0;
+
+	const auto start = steady_clock::now();
+	while (true) {
+		int pairsRead = 0;
+		while (pairsRead < chunkLen and reader.readInt(xs[pairsRead]) and reader.readInt(ys[pairsRead])) pairsRead++;
+		if (pairsRead == 0) break;
+
+		parallelForEachChunk(0, pairsRead - 1, [&](const int first, const int last) {
+			for (int i = first; i <= last; i++) {
+				const int x = xs[i], y = ys[i];
+				if (x < 1 or y < 1 or y > totalNodes()) results[i] = -1;
+				else if (method == BLOOM_FILTER_SEARCH) results[i] = searchUsingBloomFilter(x, y);
+				else if (method == LABEL_SEARCH) results[i] = searchUsingLabels(x, y);
+				else results[i] = searchUsingDFS(x, y);
+			}
+		});
 
-	while (not dfsStack.empty()) {
-		const int currentNode = dfsStack.top();
-		if (currentNode == isThisNumber) return true;
-		dfsStack.pop();
-		for (const int &factorOfCurrentNode: adjacencyList[currentNode].first) dfsStack.push(factorOfCurrentNode);
+		char *end = output.data();
+		for (int i = 0; i < pairsRead; i++) {
+			end = to_chars(end, end + 2, (int)results[i]).ptr;
+			*end++ = '\n';
+		}
+		fwrite(output.data(), 1, end - output.data(), stdout);
+		totalQueries += pairsRead;
+		if (pairsRead < chunkLen) break;
 	}
+	fflush(stdout);
 
-	return false;
+	const double seconds = duration<double>(steady_clock::now() - start).count();
+	cerr << "Answered " << totalQueries << " Queries using " << searchMethodName(method) << " in " << seconds * 1000
+		 << " Milliseconds (" << (long long)(totalQueries / max(seconds, 1e-9)) << " Queries/Second)" << endl;
 }
 
-bool searchUsingBloomFilter(const int isThisNumber, const int aFactorOfThisNumber) {
-	bool result = adjacencyList[aFactorOfThisNumber].second.contains(isThisNumber);
-	if (result == false) return false;	// if result==false, then result is definately false
+// sets one setting of a graph, the same keys are used by the command line, --graph and the config file
+bool parseGraphSetting(const string &key, const string &value, GraphConfig &config) {
+	if (key == "filter") return parseFilterType(value, config.filterType);
 
-	// else it is a probable true and could be a  false positive, so check the cache that maintains previous false positive results
-	if (inCache(isThisNumber, aFactorOfThisNumber)) return false;
+	char *end;
+	const double number = strtod(value.c_str(), &end);
+	if (value.empty() or *end != '\0') return false;
+	if (key == "nodes" and number >= 2 and number <= 1e9) config.totalNodes = number;
+	else if (key == "fpp" and number > 0 and number < 100) config.falsePositivityRateInPC = number;
+	else if (key == "cache" and number >= 0 and number <= 1e9) config.cacheLenLimit = number;
+	else if (key == "exact" and (number == 0 or number == 1)) config.exactSmallNodes = number;
+	else if (key == "stats" and (number == 0 or number == 1)) config.queryStats = number;
+	else return false;
+	return true;
+}
 
-	result = searchUsingDFS(isThisNumber, aFactorOfThisNumber);
-	if (result == false) cacheFalsePositiveResult(isThisNumber, aFactorOfThisNumber);
-	return result;
+// parses a graph written as key=value settings separated by commas or whitespace, eg "nodes=200001,fpp=0.5,filter=blocked"
+bool parseGraphSpec(const string &spec, GraphConfig &config) {
+	string setting;
+	stringstream settings(spec);
+	while (settings >> setting) {
+		stringstream items(setting);
+		for (string item; getline(items, item, ',');) {
+			const size_t separator = item.find('=');
+			if (item.empty()) continue;
+			if (separator == string::npos or not parseGraphSetting(item.substr(0, separator), item.substr(separator + 1), config)) return false;
+		}
+	}
+	return true;
 }
 
-#include <chrono>
-void compareExecTime() {
-	using namespace std::chrono;
+// every line of the config file that is not empty or a # comment describes one more graph
+bool readConfigFile(const char *path, vector<GraphConfig> &configs) {
+	ifstream file(path);
+	if (not file) return false;
+	for (string line; getline(file, line);) {
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == string::npos) continue;
+		GraphConfig config;
+		if (not parseGraphSpec(line, config)) return false;
+		configs.push_back(config);
+	}
+	return true;
+}
 
-	auto start = high_resolution_clock::now();
-	searchUsingDFS(2, TOTAL_NODES - 2);
-	auto stop = high_resolution_clock::now();
-	auto duration = duration_cast<microseconds>(stop - start);
-	cout << "DFS took: " << duration.count() << " Microseconds" << endl;
-
-	start = high_resolution_clock::now();
-	searchUsingBloomFilter(2, TOTAL_NODES - 2);
-	stop = high_resolution_clock::now();
-	duration = duration_cast<microseconds>(stop - start);
-	cout << "DFS + Bloom Filter with False+ve Caching took: " << duration.count() << " Microseconds" << endl;
+void printUsage(const char *program) {
+	cerr << "Usage: " << program << " [graph settings] [--graph <settings>]... [--config <file>] [--no-print-graph] [--format text|edges|dot] [--export <file>] [--snapshot <file>] [--batch <file or - for stdin> [--mode bloom|dfs|labels] [--stats-file <file>]]\n"
+		 << "  --nodes 20001 --fpp 1 --cache <entries> --filter standard           the graph that answers the queries\n"
+		 << "  --filter standard|blocked|counting|cuckoo|fuse                      the node filters, only bloom filters can be saved to a snapshot\n"
+		 << "  --exact 0|1                                                         exact sets for the nodes whose factors fit in the size of their filter\n"
+		 << "  --stats 0|1 --stats-file <file>                                     count and time every stage of [2], written as json or as prometheus to a .prom file\n"
+		 << "  --graph nodes=200001,fpp=0.5,cache=0,filter=blocked                 one more graph to compare with it, can be repeated\n"
+		 << "  --config <file>                                                     one more graph per line, written like --graph\n"
+		 << "  --format text|edges|dot --export <file>                             how the queried graph is printed and the file it is written to\n"
+		 << "  --snapshot <file>                                                   map the queried graph from the file, build and save it there if it doesnt match\n"
+		 << "The cache holds fpp % of the nodes unless it is set. Without --batch the interactive menu is started" << endl;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
 	ios_base::sync_with_stdio(false);  // improves io in c++
 
-	cout << "Please wait while the graph of " << TOTAL_NODES << " nodes is being generated, this might take a while..." << endl;
-	GraphBuilder();
+	const char *batchPath = nullptr;
+	SearchMethod batchMethod = BLOOM_FILTER_SEARCH;
+	vector<GraphConfig> configs(1);	 // configs[0] is the graph that answers the queries
+	for (int i = 1; i < argc; i++) {
+		bool parsed = true;
+		if (strcmp(argv[i], "--no-print-graph") == 0) printGraphAfterBuild = false;
+		else if (i + 1 == argc) parsed = false;
+		else if (strcmp(argv[i], "--batch") == 0) batchPath = argv[++i];
+		else if (strcmp(argv[i], "--snapshot") == 0) snapshotPath = argv[++i];
+		else if (strcmp(argv[i], "--export") == 0) exportPath = argv[++i];
+		else if (strcmp(argv[i], "--stats-file") == 0) statsPath = argv[++i];
+		else if (strcmp(argv[i], "--format") == 0) {
+			const string format = argv[++i];
+			parsed = format == "text" or format == "edges" or format == "dot";
+			printFormat = format == "edges" ? EDGE_LIST_FORMAT : format == "dot" ? DOT_FORMAT : TEXT_FORMAT;
+		}
+		else if (strcmp(argv[i], "--mode") == 0) {
+			const string mode = argv[++i];
+			parsed = mode == "bloom" or mode == "dfs" or mode == "labels";
+			batchMethod = mode == "dfs" ? DFS_SEARCH : mode == "labels" ? LABEL_SEARCH : BLOOM_FILTER_SEARCH;
+		}
+		else if (strcmp(argv[i], "--graph") == 0) {
+			configs.emplace_back();
+			parsed = parseGraphSpec(argv[++i], configs.back());
+		} else if (strcmp(argv[i], "--config") == 0) {
+			parsed = readConfigFile(argv[++i], configs);
+			if (not parsed) cerr << "Cannot read " << argv[i] << endl;
+		} else if (strncmp(argv[i], "--", 2) == 0) {
+			parsed = parseGraphSetting(argv[i] + 2, argv[i + 1], configs[0]);
+			i++;
+		} else parsed = false;
+
+		if (not parsed) {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	for (const GraphConfig &config: configs) divisorGraphs.push_back(make_unique<DivisorGraph>(config));
+
+	if (batchPath) {
+		FILE *input = strcmp(batchPath, "-") == 0 ? stdin : fopen(batchPath, "rb");
+		if (not input) {
+			cerr << "Cannot open " << batchPath << endl;
+			return 1;
+		}
+		cout.rdbuf(cerr.rdbuf());  // stdout only carries the answers in batch mode, everything else goes to stderr
+		GraphBuilder(queriedGraph(), false, snapshotPath);
+		if (batchMethod == LABEL_SEARCH) labelGraph();
+		answerBatch(input, batchMethod);
+		if (input != stdin) fclose(input);
+		const bool prometheus = statsPath.size() > 5 and statsPath.compare(statsPath.size() - 5, 5, ".prom") == 0;
+		if (not statsPath.empty() and not exportStats(statsPath, prometheus ? PROMETHEUS_STATS : JSON_STATS)) cerr << "Could not write " << statsPath << endl;
+		return 0;
+	}
+
+	for (size_t i = 0; i < divisorGraphs.size(); i++) GraphBuilder(*divisorGraphs[i], i == 0 and printGraphAfterBuild, i == 0 ? snapshotPath : "");
 
 	cout << "\n\n[1] Query using DFS" << endl;
 	cout << "[2] Query using DFS+Caching+BloomFilter" << endl;
-	cout << "[3] Compare Execution Time of [1] and [2]" << endl;
+	cout << "[3] Compare Execution Time of [1], [2] and [9]" << endl;
+	cout << "[4] Find all factors of Y using a batch query of its BloomFilter" << endl;
+	cout << "[5] Measure Queries/Second of [2] on 1 to " << workerCount() << " Threads" << endl;
+	cout << "[6] Compare Memory and Latency of [2] on all " << divisorGraphs.size() << " Configured Graphs" << endl;
+	cout << "[7] Remove or Restore Node Y(needs filter=counting)" << endl;
+	cout << "[8] Grow the Graph to N Nodes without Rebuilding it" << endl;
+	cout << "[9] Query using the Exact Prime Label Index" << endl;
+	cout << "[10] Export the Query Statistics of [2]" << (queriedGraph().stats().isEnabled() ? "" : "(needs stats=1)") << endl;
 	cout << "[0] Exit" << endl;
 
 	int choice;
@@ -151,7 +360,7 @@ int main() {
 		cout << "\n-> ";
 		cin >> choice;
 		if (choice == 0) return 0;
-		if (choice != 1 and choice != 2 and choice != 3) {
+		if (choice < 1 or choice > 10) {
 			cout << "Invalid Choice, Try Again!" << endl;
 			continue;
 		}
@@ -159,6 +368,61 @@ int main() {
 			compareExecTime();
 			continue;
 		}
+		if (choice == 5) {
+			measureQueryThroughput();
+			continue;
+		}
+		if (choice == 6) {
+			compareGraphs();
+			continue;
+		}
+		if (choice == 7) {
+			int y;
+			cout << "Enter Y: ";
+			cin >> y;
+			DivisorGraph &divisorGraph = queriedGraph();
+			const bool removing = not divisorGraph.isRemoved(y);
+			if (removing ? divisorGraph.removeNode(y) : divisorGraph.restoreNode(y)) cout << y << (removing ? " has been removed" : " has been restored") << endl;
+			else cout << "Only nodes from 2 to " << totalNodes() << " of a graph with counting bloom filters that was not mapped from a snapshot can be updated" << endl;
+			continue;
+		}
+		if (choice == 8) {
+			int newTotalNodes;
+			cout << "Enter N: ";
+			cin >> newTotalNodes;
+			if (newTotalNodes > 1e9) {	// the same bound as --nodes, the sieve steps past the last node and must not overflow an int
+				cout << "Input Out Of Range, Try Again!" << endl;
+				continue;
+			}
+			const auto extendTime = chrono::duration<double, milli>(queriedGraph().extend(newTotalNodes)).count();
+			if (extendTime < 0) cout << "Only a graph that was not mapped from a snapshot can grow, and only to more than " << totalNodes() << " nodes" << endl;
+			else cout << "GRAPH HAS GROWN TO " << totalNodes() << " NODES IN " << extendTime << " Milliseconds!" << endl;
+			continue;
+		}
+		if (choice == 10) {
+			string format, path;
+			cout << "Enter Format(json or prometheus): ";
+			cin >> format;
+			cout << "Enter File(- for the screen): ";
+			cin >> path;
+			if (format != "json" and format != "prometheus") cout << "Invalid Format, Try Again!" << endl;
+			else if (not exportStats(path, format == "json" ? JSON_STATS : PROMETHEUS_STATS)) cout << "Could not write " << path << endl;
+			else if (path != "-") cout << "Exported the query statistics to " << path << endl;
+			continue;
+		}
+		if (choice == 4) {
+			int y;
+			cout << "Enter Y: ";
+			cin >> y;
+			if (y < 1 or y > totalNodes()) {
+				cout << "Input Out Of Range, Try Again!" << endl;
+				continue;
+			}
+			cout << "Factors of " << y << " : ";
+			for (const int &factor: queriedGraph().findFactorsUsingBloomFilter(y)) cout << factor << " ";
+			cout << endl;
+			continue;
+		}
 
 		cout << "Check if X is a factor of Y" << endl;
 		int x, y;
@@ -166,7 +430,7 @@ int main() {
 		cin >> x;
 		cout << "Enter Y: ";
 		cin >> y;
-		if (x > TOTAL_NODES or y > TOTAL_NODES) {
+		if (x < 1 or y < 1 or x > totalNodes() or y > totalNodes()) {
 			cout << "Input Out Of Range, Try Again!" << endl;
 			continue;
 		}
@@ -177,6 +441,10 @@ int main() {
 				break;
 			case 2:
 				cout << x << " is " << (searchUsingBloomFilter(x, y) ? "" : "not a ") << "factor of " << y << endl;
+				break;
+			case 9:
+				labelGraph();
+				cout << x << " is " << (searchUsingLabels(x, y) ? "" : "not a ") << "factor of " << y << endl;
 		}
 	}
 
@@ -0,0 +1,683 @@
+#ifndef INCLUDE_NODE_FILTERS_HPP
+#define INCLUDE_NODE_FILTERS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bloom_filter.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>	// compares a whole exact set of a few keys at once
+#endif
+
+// which probabilistic filter tells for every node n whether x may be a factor of n before the cache and the DFS are asked
+// the bloom filter types have the values of their bloom_filter_layout, snapshots store them
+enum NodeFilterType {
+	STANDARD_BLOOM_FILTER,
+	BLOCKED_BLOOM_FILTER,	 // touches a single cache line per query at a slightly higher false +ve rate
+	COUNTING_BLOOM_FILTER,	 // 4 times larger but lets nodes be removed and restored
+	CUCKOO_FILTER,			 // 2 buckets per query, fingerprints instead of bits
+	BINARY_FUSE_FILTER		 // static, built from all the keys of a node at once, 3 memory accesses per query
+};
+
+inline const char *filterTypeName(const NodeFilterType type) {
+	switch (type) {
+		case STANDARD_BLOOM_FILTER: return "standard";
+		case BLOCKED_BLOOM_FILTER: return "blocked";
+		case COUNTING_BLOOM_FILTER: return "counting";
+		case CUCKOO_FILTER: return "cuckoo";
+		case BINARY_FUSE_FILTER: return "fuse";
+	}
+	return "unknown";
+}
+
+inline bool parseFilterType(const std::string &name, NodeFilterType &type) {
+	for (const NodeFilterType candidate: {STANDARD_BLOOM_FILTER, BLOCKED_BLOOM_FILTER, COUNTING_BLOOM_FILTER, CUCKOO_FILTER, BINARY_FUSE_FILTER})
+		if (name == filterTypeName(candidate)) {
+			type = candidate;
+			return true;
+		}
+	return false;
+}
+
+inline bool isBloomFilter(const NodeFilterType type) { return type <= COUNTING_BLOOM_FILTER; }
+
+// the filters of every node of a graph, the graph only talks to its filters through this interface so every kind of filter
+// is sized, built, queried and measured the same way, filter n is the n-th filter that was added
+// first every filter is sized by add() and allocate(), then every filter is built from all of its keys at once, so static filters
+// that cant take keys one by one fit in as well, different filters can be built concurrently
+class NodeFilterBank {
+   public:
+	typedef std::size_t FilterId;
+
+	virtual ~NodeFilterBank() = default;
+
+	virtual const char *name() const = 0;  // eg "Bloom Filters", used in the reports
+
+	// reserves the filter of the next node for keyCount keys, allocate() has to be called after the last add() before building it
+	virtual FilterId add(std::size_t keyCount) = 0;
+	// a hint of how many filters will be added in total, so the records of a bank do not grow past what they hold
+	virtual void reserve(std::size_t) {}
+	// makes room for every filter added so far, the filters that were built already keep their keys
+	virtual void allocate() = 0;
+	// fills filter id with all of its keys, every filter is built once
+	virtual void build(FilterId id, const int *keys, std::size_t count) = 0;
+	// bytes that add(keyCount) reserves for the table of one filter, not const because a bank may keep what it computed
+	virtual std::size_t tableBytes(std::size_t keyCount) = 0;
+
+	virtual bool contains(FilterId id, int key) const = 0;
+	// an exact filter never answers a false +ve, so a positive of contains() needs no confirmation
+	virtual bool exact(FilterId) const { return false; }
+
+	// bit i of result, which holds (count + 63) / 64 words, is set when keys[i] may be in filter id
+	virtual void containsBatch(const FilterId id, const int *keys, const std::size_t count, unsigned long long *result) const {
+		std::fill(result, result + (count + 63) / 64, 0ULL);
+		for (std::size_t i = 0; i < count; i++)
+			if (contains(id, keys[i])) result[i / 64] |= 1ULL << (i % 64);
+	}
+
+	virtual double effectiveFpp(FilterId id) const = 0;  // the false +ve rate filter id expects from its size and its keys
+	virtual std::size_t keyCount() const = 0;			 // keys in every filter together
+	virtual std::size_t memoryUsage() const = 0;
+
+	// updates of a built filter, filters that dont support them return false and stay unchanged
+	virtual bool insert(FilterId, int) { return false; }
+	virtual bool erase(FilterId, int) { return false; }
+	virtual bool clear(FilterId) { return false; }
+
+	// a bank that can be written into a snapshot and mapped back from it, a snapshotSize() of 0 means it cant
+	virtual std::size_t snapshotSize() const { return 0; }
+	virtual bool writeSnapshot(std::ostream &) const { return false; }
+	// filterCount is the number of filters the graph expects, a snapshot of any other bank is rejected
+	virtual bool attachSnapshot(const unsigned char *, std::size_t, std::size_t) { return false; }
+};
+
+// standard, blocked or counting bloom filters, every filter of the graph lives in a single bloom_filter_bank
+class BloomFilterBank final : public NodeFilterBank {
+   public:
+	BloomFilterBank(const bloom_parameters &parameters, const bloom_filter_layout layout) : bank(parameters), layout(layout) {}
+
+	const char *name() const override {
+		return layout == blocked_layout ? "Blocked Bloom Filters" : layout == counting_layout ? "Counting Bloom Filters" : "Bloom Filters";
+	}
+
+	void reserve(const std::size_t filterCount) override { bank.reserve(filterCount); }
+	FilterId add(const std::size_t keyCount) override { return bank.add(keyCount, layout); }
+	void allocate() override { bank.allocate(); }
+	void build(const FilterId id, const int *keys, const std::size_t count) override {
+		for (std::size_t i = 0; i < count; i++) bank.insert(id, keys[i]);
+	}
+	std::size_t tableBytes(const std::size_t keyCount) override { return bank.table_bytes_for(keyCount, layout); }
+
+	bool contains(const FilterId id, const int key) const override { return bank.contains(id, key); }
+	void containsBatch(const FilterId id, const int *keys, const std::size_t count, unsigned long long *result) const override {
+		bank.contains_batch(id, keys, count, result);	// vectorized for standard filters
+	}
+
+	double effectiveFpp(const FilterId id) const override { return bank.effective_fpp(id); }
+	std::size_t keyCount() const override {
+		std::size_t keys = 0;
+		for (std::size_t id = 0; id < bank.filter_count(); id++) keys += bank.element_count(id);
+		return keys;
+	}
+	std::size_t memoryUsage() const override { return bank.memory_usage(); }
+
+	bool insert(const FilterId id, const int key) override {
+		bank.insert(id, key);
+		return true;
+	}
+	bool erase(const FilterId id, const int key) override { return bank.erase(id, key); }	// only counting filters can erase
+	bool clear(const FilterId id) override {
+		bank.clear(id);
+		return true;
+	}
+
+	std::size_t snapshotSize() const override { return bank.snapshot_size(); }
+	bool writeSnapshot(std::ostream &out) const override { return bank.write_snapshot(out); }
+	bool attachSnapshot(const unsigned char *data, const std::size_t length, const std::size_t filterCount) override {
+		return bank.attach_snapshot(data, length, filterCount);
+	}
+
+   private:
+	bloom_filter_bank bank;
+	const bloom_filter_layout layout;
+};
+
+// murmur3 finalizer of key + seed, every bit of the key affects every bit of the hash
+inline uint64_t mixFilterKey(const int key, const uint64_t seed) {
+	uint64_t hash = (uint64_t)(uint32_t)key + seed;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// a filter that cant be built with any of its seeds is very unlikely, it then answers true for every key and is only slow, never wrong
+inline uint64_t filterSeed(const unsigned attempt) { return 0x9E3779B97F4A7C15ULL * (attempt + 1); }
+
+// cuckoo filter(Fan et al. 2014) of every node: each key leaves a fingerprint in one of the 4 slots of one of its 2 buckets
+// so a query reads 2 buckets no matter how many keys the node has, the buckets are packed back to back with 4 fingerprints
+// in fingerprintBits / 2 bytes and each filter is first built in a scratch table, so building a filter never touches its neighbours
+class CuckooFilterBank final : public NodeFilterBank {
+   public:
+	explicit CuckooFilterBank(const double falsePositiveProbability) : fingerprintBits(fingerprintBitsFor(falsePositiveProbability)) {}
+
+	const char *name() const override { return "Cuckoo Filters"; }
+
+	void reserve(const std::size_t filterCount) override { records.reserve(filterCount); }
+
+	FilterId add(const std::size_t keyCount) override {
+		Record record;
+		record.offset = totalTableBytes;
+		record.bucketCount = bucketCountFor(keyCount);
+		totalTableBytes += (std::size_t)record.bucketCount * bucketBytes();
+		records.push_back(record);
+		return records.size() - 1;
+	}
+
+	void allocate() override { table.resize(totalTableBytes, 0); }	 // grows geometrically, built filters keep their buckets
+	std::size_t tableBytes(const std::size_t keyCount) override { return (std::size_t)bucketCountFor(keyCount) * bucketBytes(); }
+
+	void build(const FilterId id, const int *keys, const std::size_t count) override {
+		Record &record = records[id];
+		const std::size_t bytes = (std::size_t)record.bucketCount * bucketBytes();
+		static thread_local std::vector<unsigned char> scratch;
+
+		record.keyCount = count;
+		for (unsigned attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+			scratch.assign(bytes, 0);
+			record.seed = attempt;
+			std::size_t inserted = 0;
+			while (inserted < count and insertKey(record, scratch.data(), keys[inserted])) inserted++;
+			if (inserted == count) {
+				std::memcpy(table.data() + record.offset, scratch.data(), bytes);
+				return;
+			}
+		}
+		record.seed = OVERFLOWED;
+	}
+
+	bool contains(const FilterId id, const int key) const override {
+		const Record &record = records[id];
+		if (record.seed == OVERFLOWED) return true;
+		const unsigned char *buckets = table.data() + record.offset;
+		const uint64_t hash = mixFilterKey(key, filterSeed(record.seed));
+		const uint32_t fingerprint = fingerprintOf(hash), firstBucket = firstBucketOf(hash, record.bucketCount);
+		return bucketHas(buckets, firstBucket, fingerprint) or bucketHas(buckets, alternateBucket(firstBucket, fingerprint, record.bucketCount), fingerprint);
+	}
+
+	// a query compares the fingerprint of the key with the occupied slots of 2 buckets
+	double effectiveFpp(const FilterId id) const override {
+		const Record &record = records[id];
+		if (record.seed == OVERFLOWED) return 1;
+		const double occupiedSlots = 2.0 * record.keyCount / record.bucketCount;
+		return 1 - std::pow(1 - 1 / std::ldexp(1.0, fingerprintBits), occupiedSlots);
+	}
+
+	std::size_t keyCount() const override {
+		std::size_t keys = 0;
+		for (const Record &record: records) keys += record.keyCount;
+		return keys;
+	}
+
+	std::size_t memoryUsage() const override { return table.capacity() + records.capacity() * sizeof(Record); }
+
+   private:
+	static constexpr int SLOTS_PER_BUCKET = 4;
+	static constexpr double MAX_LOAD = 0.9;	 // 4 slot buckets fill up to ~95% before insertions start to fail
+	static constexpr int MAX_KICKS = 500;
+	static constexpr unsigned MAX_ATTEMPTS = 64;
+	static constexpr uint8_t OVERFLOWED = 0xFF;
+
+	// 16 bytes, nodes have ~15 keys on average so every byte of the record costs about half a bit per key
+	struct Record {
+		uint64_t offset = 0;
+		uint32_t bucketCount = 0;
+		uint16_t keyCount = 0;	// an int has at most 1600 factors
+		uint8_t seed = 0;		// the attempt that built the filter, OVERFLOWED if none could
+	};
+
+	const int fingerprintBits;	// even, so that every bucket starts on a byte
+	std::vector<Record> records;
+	std::vector<unsigned char> table;
+	std::size_t totalTableBytes = 0;
+
+	static uint32_t bucketCountFor(const std::size_t keyCount) { return std::max(1.0, std::ceil(keyCount / (SLOTS_PER_BUCKET * MAX_LOAD))); }
+
+	// a false +ve needs one of the ~2 * 4 * MAX_LOAD fingerprints of 2 buckets to match, each matches with probability 2^-fingerprintBits
+	static int fingerprintBitsFor(const double falsePositiveProbability) {
+		const int bits = std::ceil(std::log2(2 * SLOTS_PER_BUCKET * MAX_LOAD / falsePositiveProbability));
+		return std::min(16, std::max(4, (bits + 1) / 2 * 2));
+	}
+
+	std::size_t bucketBytes() const { return SLOTS_PER_BUCKET * fingerprintBits / 8; }
+	uint32_t fingerprintMask() const { return (1u << fingerprintBits) - 1; }
+
+	uint32_t fingerprintOf(const uint64_t hash) const {
+		const uint32_t fingerprint = (hash >> 32) & fingerprintMask();
+		return fingerprint ? fingerprint : 1;  // 0 marks an empty slot
+	}
+	static uint32_t firstBucketOf(const uint64_t hash, const uint32_t bucketCount) { return ((hash & 0xFFFFFFFF) * bucketCount) >> 32; }
+	// (h(fingerprint) - bucket) mod bucketCount is its own inverse, so either bucket of a key leads to the other for any bucket count
+	static uint32_t alternateBucket(const uint32_t bucket, const uint32_t fingerprint, const uint32_t bucketCount) {
+		return ((fingerprint * 0x5bd1e995u) % bucketCount + bucketCount - bucket) % bucketCount;
+	}
+
+	// the fingerprint in slot i of a bucket are bits i * fingerprintBits .. of its little endian bytes
+	uint64_t loadBucket(const unsigned char *buckets, const uint32_t bucket) const {
+		const unsigned char *bytes = buckets + bucket * bucketBytes();
+		uint64_t slots = 0;
+		for (std::size_t i = 0; i < bucketBytes(); i++) slots |= (uint64_t)bytes[i] << (8 * i);
+		return slots;
+	}
+	void storeBucket(unsigned char *buckets, const uint32_t bucket, const uint64_t slots) const {
+		unsigned char *bytes = buckets + bucket * bucketBytes();
+		for (std::size_t i = 0; i < bucketBytes(); i++) bytes[i] = slots >> (8 * i);
+	}
+
+	bool bucketHas(const unsigned char *buckets, const uint32_t bucket, const uint32_t fingerprint) const {
+		const uint64_t slots = loadBucket(buckets, bucket);
+		for (int slot = 0; slot < SLOTS_PER_BUCKET; slot++)
+			if (((slots >> (slot * fingerprintBits)) & fingerprintMask()) == fingerprint) return true;
+		return false;
+	}
+
+	bool placeInBucket(unsigned char *buckets, const uint32_t bucket, const uint32_t fingerprint) const {
+		const uint64_t slots = loadBucket(buckets, bucket);
+		for (int slot = 0; slot < SLOTS_PER_BUCKET; slot++)
+			if (((slots >> (slot * fingerprintBits)) & fingerprintMask()) == 0) {
+				storeBucket(buckets, bucket, slots | (uint64_t)fingerprint << (slot * fingerprintBits));
+				return true;
+			}
+		return false;
+	}
+
+	// places the fingerprint of key, kicking fingerprints out to their other bucket when both buckets are full
+	// a failed insertion loses a fingerprint, which is fine because build() then starts over with the next seed
+	bool insertKey(const Record &record, unsigned char *buckets, const int key) const {
+		const uint64_t hash = mixFilterKey(key, filterSeed(record.seed));
+		uint32_t fingerprint = fingerprintOf(hash), bucket = firstBucketOf(hash, record.bucketCount);
+		if (placeInBucket(buckets, bucket, fingerprint)) return true;
+		bucket = alternateBucket(bucket, fingerprint, record.bucketCount);
+		if (placeInBucket(buckets, bucket, fingerprint)) return true;
+
+		for (int kick = 0; kick < MAX_KICKS; kick++) {
+			const int slot = (kick + fingerprint) % SLOTS_PER_BUCKET;
+			const uint64_t slots = loadBucket(buckets, bucket), slotMask = (uint64_t)fingerprintMask() << (slot * fingerprintBits);
+			const uint32_t evicted = (slots & slotMask) >> (slot * fingerprintBits);
+			storeBucket(buckets, bucket, (slots & ~slotMask) | (uint64_t)fingerprint << (slot * fingerprintBits));
+
+			fingerprint = evicted;
+			bucket = alternateBucket(bucket, fingerprint, record.bucketCount);
+			if (placeInBucket(buckets, bucket, fingerprint)) return true;
+		}
+		return false;
+	}
+};
+
+// binary fuse filter(Graf and Lemire 2022) of every node: a static filter built from all keys of the node at once
+// every key maps to 3 slots in 3 consecutive segments of an array of fingerprints, the slots are assigned by peeling so that
+// the xor of the 3 slots of every key is the fingerprint of the key, so a query is always exactly 3 reads and a compare
+// fingerprints are 8 bits(~0.4% false +ve at ~9 bits per key on large sets) or 16 bits when the target is below 1/256
+class BinaryFuseFilterBank final : public NodeFilterBank {
+   public:
+	explicit BinaryFuseFilterBank(const double falsePositiveProbability) : fingerprintBytes(falsePositiveProbability < 1.0 / 256 ? 2 : 1) {}
+
+	const char *name() const override { return "Binary Fuse Filters"; }
+
+	void reserve(const std::size_t filterCount) override { records.reserve(filterCount); }
+
+	FilterId add(const std::size_t keyCount) override {
+		Record record = sizedFor(keyCount);
+		record.offset = totalTableBytes;
+		totalTableBytes += arrayLength(record) * fingerprintBytes;
+		records.push_back(record);
+		return records.size() - 1;
+	}
+
+	void allocate() override { table.resize(totalTableBytes, 0); }	 // grows geometrically, built filters keep their fingerprints
+	std::size_t tableBytes(const std::size_t keyCount) override { return arrayLength(sizedFor(keyCount)) * fingerprintBytes; }
+
+	void build(const FilterId id, const int *keys, const std::size_t count) override {
+		Record &record = records[id];
+		const std::size_t slots = arrayLength(record);
+		static thread_local std::vector<uint32_t> degree;
+		static thread_local std::vector<uint64_t> xorOfHashes;
+		static thread_local std::vector<uint32_t> peelQueue;
+		static thread_local std::vector<std::pair<uint64_t, uint32_t>> peeled;  // (hash of a key, the slot that was assigned to it)
+		static thread_local std::vector<uint16_t> fingerprints;
+
+		record.keyCount = count;
+		if (count == 0) return;
+		for (unsigned attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+			record.seed = attempt;
+			degree.assign(slots, 0), xorOfHashes.assign(slots, 0);
+			for (std::size_t k = 0; k < count; k++) {
+				const uint64_t hash = mixFilterKey(keys[k], filterSeed(attempt));
+				uint32_t at[ARITY];
+				slotsOf(record, hash, at);
+				for (const uint32_t slot: at) degree[slot]++, xorOfHashes[slot] ^= hash;
+			}
+
+			// a slot that only one key maps to can be given to that key, which removes the key from its other slots and so on
+			peelQueue.clear(), peeled.clear();
+			for (uint32_t slot = 0; slot < slots; slot++)
+				if (degree[slot] == 1) peelQueue.push_back(slot);
+			while (not peelQueue.empty()) {
+				const uint32_t slot = peelQueue.back();
+				peelQueue.pop_back();
+				if (degree[slot] != 1) continue;
+				const uint64_t hash = xorOfHashes[slot];
+				peeled.emplace_back(hash, slot);
+				uint32_t at[ARITY];
+				slotsOf(record, hash, at);
+				for (const uint32_t other: at) {
+					degree[other]--, xorOfHashes[other] ^= hash;
+					if (degree[other] == 1) peelQueue.push_back(other);
+				}
+			}
+			if (peeled.size() != count) continue;  // a cycle is left, try the next seed
+
+			// the last key that was peeled gets its slot first, every other slot it maps to is final by then
+			fingerprints.assign(slots, 0);
+			for (auto key = peeled.rbegin(); key != peeled.rend(); key++) {
+				uint32_t at[ARITY];
+				slotsOf(record, key->first, at);
+				fingerprints[key->second] = fingerprintOf(key->first) ^ fingerprints[at[0]] ^ fingerprints[at[1]] ^ fingerprints[at[2]];
+			}
+			unsigned char *array = table.data() + record.offset;
+			for (std::size_t slot = 0; slot < slots; slot++) storeFingerprint(array, slot, fingerprints[slot]);
+			return;
+		}
+		record.seed = OVERFLOWED;
+	}
+
+	bool contains(const FilterId id, const int key) const override {
+		const Record &record = records[id];
+		if (record.seed == OVERFLOWED) return true;
+		if (record.keyCount == 0) return false;
+		const unsigned char *array = table.data() + record.offset;
+		const uint64_t hash = mixFilterKey(key, filterSeed(record.seed));
+		uint32_t at[ARITY];
+		slotsOf(record, hash, at);
+		return (fingerprintOf(hash) ^ loadFingerprint(array, at[0]) ^ loadFingerprint(array, at[1]) ^ loadFingerprint(array, at[2])) == 0;
+	}
+
+	double effectiveFpp(const FilterId id) const override {
+		const Record &record = records[id];
+		return record.seed == OVERFLOWED ? 1 : record.keyCount == 0 ? 0 : std::ldexp(1.0, -8 * fingerprintBytes);
+	}
+
+	std::size_t keyCount() const override {
+		std::size_t keys = 0;
+		for (const Record &record: records) keys += record.keyCount;
+		return keys;
+	}
+
+	std::size_t memoryUsage() const override { return table.capacity() + records.capacity() * sizeof(Record); }
+
+   private:
+	static constexpr int ARITY = 3;
+	static constexpr unsigned MAX_ATTEMPTS = 64;
+	static constexpr uint8_t OVERFLOWED = 0xFF;
+
+	struct Record {
+		uint64_t offset = 0;
+		uint32_t segmentCountLength = 0;  // slots of every segment a key can start in, the array has ARITY - 1 more segments
+		uint16_t keyCount = 0;			  // an int has at most 1600 factors
+		uint8_t segmentLengthBits = 0;	  // segments are 1 << segmentLengthBits slots long
+		uint8_t seed = 0;				  // the attempt that built the filter, OVERFLOWED if none could
+	};
+
+	const int fingerprintBytes;
+	std::vector<Record> records;
+	std::vector<unsigned char> table;
+	std::size_t totalTableBytes = 0;
+
+	// the segment length and the size factor of the reference implementation, small sets need a much larger size factor to peel
+	static Record sizedFor(const std::size_t keyCount) {
+		Record record;
+		if (keyCount == 0) return record;
+		record.segmentLengthBits = std::min(18, (int)std::floor(std::log((double)keyCount) / std::log(3.33) + 2.25));
+		const long long segmentLength = 1LL << record.segmentLengthBits;
+		const double sizeFactor = keyCount <= 1 ? 0 : std::max(1.125, 0.875 + 0.25 * std::log(1e6) / std::log((double)keyCount));
+		const long long capacity = std::llround(keyCount * sizeFactor);
+		const long long segmentCount = std::max(1LL, (capacity + segmentLength - 1) / segmentLength - (ARITY - 1));
+		record.segmentCountLength = segmentCount * segmentLength;
+		return record;
+	}
+
+	static std::size_t arrayLength(const Record &record) {
+		return record.segmentCountLength ? record.segmentCountLength + ((std::size_t)(ARITY - 1) << record.segmentLengthBits) : 0;  // 0 for empty filters
+	}
+
+	// the first slot in the first segment from the high bits, the other 2 in the following segments from the low bits
+	static void slotsOf(const Record &record, const uint64_t hash, uint32_t at[ARITY]) {
+		const uint64_t high = (hash >> 32) * record.segmentCountLength, low = (hash & 0xFFFFFFFF) * record.segmentCountLength;
+		const uint32_t segmentLength = 1u << record.segmentLengthBits, segmentLengthMask = segmentLength - 1;
+		at[0] = (high + (low >> 32)) >> 32;	 // (hash * segmentCountLength) >> 64
+		at[1] = (at[0] + segmentLength) ^ ((hash >> 18) & segmentLengthMask);
+		at[2] = (at[0] + 2 * segmentLength) ^ (hash & segmentLengthMask);
+	}
+
+	uint16_t fingerprintOf(const uint64_t hash) const {
+		const uint64_t fingerprint = hash ^ (hash >> 32);
+		return fingerprintBytes == 1 ? (uint8_t)fingerprint : (uint16_t)fingerprint;
+	}
+
+	uint16_t loadFingerprint(const unsigned char *array, const uint32_t slot) const {
+		if (fingerprintBytes == 1) return array[slot];
+		uint16_t fingerprint;
+		std::memcpy(&fingerprint, array + 2 * (std::size_t)slot, sizeof(fingerprint));
+		return fingerprint;
+	}
+	void storeFingerprint(unsigned char *array, const std::size_t slot, const uint16_t fingerprint) const {
+		if (fingerprintBytes == 1) array[slot] = fingerprint;
+		else std::memcpy(array + 2 * slot, &fingerprint, sizeof(fingerprint));
+	}
+};
+
+// gives every node whose keys take no more bytes as an exact set than as a filter of the wrapped bank an exact set instead
+// so nodes with few factors(primes, p^2, pq, ...) never answer a false +ve and never fall back to the DFS
+// relies on filter n belonging to node n and holding keys from 1 to n only: 1 and n are two flags, the other keys are
+// a sorted array of 16 bit keys below node 65536 and of 32 bit keys above it, or a bitset of 0 .. n when that is even smaller
+// a rank bitset tells which nodes are exact, so only exact nodes have a record here and the other nodes cost 1.5 bits each
+class ExactSetFilterBank final : public NodeFilterBank {
+   public:
+	explicit ExactSetFilterBank(std::unique_ptr<NodeFilterBank> fallback) : fallback(std::move(fallback)), label(std::string("Exact Sets + ") + this->fallback->name()) {}
+
+	const char *name() const override { return label.c_str(); }
+
+	// only the rank bitset is reserved, how many records go to the exact sets and how many to the fallback is known after the adds
+	void reserve(const std::size_t filterCount) override {
+		exactBits.reserve(filterCount / 64 + 1);
+		exactBefore.reserve(filterCount / 64 + 1);
+	}
+
+	FilterId add(const std::size_t keyCount) override {
+		const FilterId id = filterCount++;
+		if (id % 64 == 0) exactBits.push_back(0), exactBefore.push_back(records.size());
+
+		const std::size_t storedKeys = keyCount > 2 ? keyCount - 2 : 0, keyBytes = id < 65536 ? 2 : 4;
+		const std::size_t arrayBytes = storedKeys * keyBytes, bitsetBytes = id / 8 + 1;
+		if (std::min(arrayBytes, bitsetBytes) > fallback->tableBytes(keyCount)) {
+			fallback->add(keyCount);  // gets id - rank(id), the fallback only sees the nodes that are not exact
+			return id;
+		}
+
+		Record record;
+		record.kind = bitsetBytes < arrayBytes ? BITSET : keyBytes == 2 ? ARRAY16 : ARRAY32;
+		const std::size_t alignment = record.kind == BITSET ? 1 : keyBytes;
+		record.offset = (totalExactBytes + alignment - 1) / alignment * alignment;
+		record.capacity = storedKeys;
+		totalExactBytes = record.offset + (record.kind == BITSET ? bitsetBytes : arrayBytes);
+		exactBits.back() |= 1ULL << (id % 64);
+		records.push_back(record);
+		return id;
+	}
+
+	void allocate() override {
+		fallback->allocate();
+		exactTable.resize(totalExactBytes + 16, 0);	 // the compare of the last array may read 16 bytes past its start
+	}
+
+	void build(const FilterId id, const int *keys, const std::size_t count) override {
+		if (not exact(id)) return fallback->build(id - rank(id), keys, count);
+		for (std::size_t i = 0; i < count; i++) insert(id, keys[i]);
+	}
+
+	std::size_t tableBytes(const std::size_t keyCount) override { return fallback->tableBytes(keyCount); }	// at most
+
+	bool contains(const FilterId id, const int key) const override {
+		if (not exact(id)) return fallback->contains(id - rank(id), key);
+		const Record &record = records[rank(id)];
+		if (key == 1) return record.flags & HAS_ONE;
+		if (key == (int)id) return record.flags & HAS_ITSELF;
+		if (key < 1 or key > (int)id) return false;
+
+		const unsigned char *table = exactTable.data() + record.offset;
+		if (record.kind == BITSET) return table[key / 8] >> (key % 8) & 1;
+		if (record.kind == ARRAY16) return arrayContains((const uint16_t *)table, record.count, key);
+		return arrayContains((const uint32_t *)table, record.count, key);
+	}
+
+	void containsBatch(const FilterId id, const int *keys, const std::size_t count, unsigned long long *result) const override {
+		if (not exact(id)) return fallback->containsBatch(id - rank(id), keys, count, result);
+		NodeFilterBank::containsBatch(id, keys, count, result);
+	}
+
+	bool exact(const FilterId id) const override { return exactBits[id / 64] >> (id % 64) & 1; }
+
+	double effectiveFpp(const FilterId id) const override { return exact(id) ? 0 : fallback->effectiveFpp(id - rank(id)); }
+
+	std::size_t keyCount() const override {
+		std::size_t keys = fallback->keyCount();
+		for (const Record &record: records) keys += record.count + ((record.flags & HAS_ONE) != 0) + ((record.flags & HAS_ITSELF) != 0);
+		return keys;
+	}
+
+	std::size_t memoryUsage() const override {
+		return fallback->memoryUsage() + exactTable.capacity() + records.capacity() * sizeof(Record) + exactBits.capacity() * sizeof(uint64_t) +
+			   exactBefore.capacity() * sizeof(uint32_t);
+	}
+
+	std::size_t exactCount() const { return records.size(); }
+
+	// an array never grows past the keys it was built with, so a removed key can always be inserted again
+	bool insert(const FilterId id, const int key) override {
+		if (not exact(id)) return fallback->insert(id - rank(id), key);
+		Record &record = records[rank(id)];
+		if (key == 1 or key == (int)id) {
+			record.flags |= key == 1 ? HAS_ONE : HAS_ITSELF;
+			return true;
+		}
+		if (key < 1 or key > (int)id) return false;
+		if (contains(id, key)) return true;
+
+		unsigned char *table = exactTable.data() + record.offset;
+		if (record.kind == BITSET) table[key / 8] |= 1 << (key % 8);
+		else if (record.count == record.capacity) return false;
+		else if (record.kind == ARRAY16) insertSorted((uint16_t *)table, record.count, (uint16_t)key);
+		else insertSorted((uint32_t *)table, record.count, (uint32_t)key);
+		record.count++;
+		return true;
+	}
+
+	bool erase(const FilterId id, const int key) override {
+		if (not exact(id)) return fallback->erase(id - rank(id), key);
+		if (not contains(id, key)) return false;
+		Record &record = records[rank(id)];
+		if (key == 1 or key == (int)id) {
+			record.flags &= ~(key == 1 ? HAS_ONE : HAS_ITSELF);
+			return true;
+		}
+
+		unsigned char *table = exactTable.data() + record.offset;
+		if (record.kind == BITSET) table[key / 8] &= ~(1 << (key % 8));
+		else if (record.kind == ARRAY16) eraseSorted((uint16_t *)table, record.count, (uint16_t)key);
+		else eraseSorted((uint32_t *)table, record.count, (uint32_t)key);
+		record.count--;
+		return true;
+	}
+
+	bool clear(const FilterId id) override {
+		if (not exact(id)) return fallback->clear(id - rank(id));
+		Record &record = records[rank(id)];
+		if (record.kind == BITSET) std::fill_n(exactTable.begin() + record.offset, id / 8 + 1, 0);
+		record.count = 0, record.flags = 0;
+		return true;
+	}
+
+   private:
+	enum Kind { BITSET, ARRAY16, ARRAY32 };
+	enum Flags { HAS_ONE = 1, HAS_ITSELF = 2 };
+	static constexpr std::size_t SCAN_LIMIT = 32;  // longer arrays are binary searched
+
+	// 8 bytes for every exact node
+	struct Record {
+		uint64_t offset : 36;  // into exactTable
+		uint64_t kind : 2;
+		uint64_t flags : 2;
+		uint64_t count : 12;	 // keys in the array or bits set in the bitset besides 1 and the node, an int has at most 1600 factors
+		uint64_t capacity : 12;	 // keys the array was sized for
+
+		Record() : offset(0), kind(BITSET), flags(0), count(0), capacity(0) {}
+	};
+
+	std::unique_ptr<NodeFilterBank> fallback;
+	const std::string label;
+	std::size_t filterCount = 0;
+	std::vector<uint64_t> exactBits;	 // bit n is set when node n has an exact set
+	std::vector<uint32_t> exactBefore;	 // exact nodes before the nodes of word i of exactBits, so a rank is a single popcount
+	std::vector<Record> records;		 // of the exact nodes in ascending order, the record of node n is records[rank(n)]
+	std::vector<unsigned char> exactTable;
+	std::size_t totalExactBytes = 0;
+
+	// exact nodes before node id
+	std::size_t rank(const FilterId id) const { return exactBefore[id / 64] + __builtin_popcountll(exactBits[id / 64] & ((1ULL << (id % 64)) - 1)); }
+
+	// compares the key with 8(16 bit) or 4(32 bit) keys at once, short arrays are scanned whole since they fit in a few compares
+	template <typename Key>
+	static bool arrayContains(const Key *keys, const std::size_t count, const int key) {
+		if ((uint64_t)(unsigned)key > (Key)~0) return false;
+#if defined(__SSE2__)
+		if (count <= SCAN_LIMIT) {
+			const std::size_t lanes = 16 / sizeof(Key);
+			const __m128i wanted = sizeof(Key) == 2 ? _mm_set1_epi16((short)key) : _mm_set1_epi32(key);
+			for (std::size_t i = 0; i < count; i += lanes) {
+				const __m128i block = _mm_loadu_si128((const __m128i *)(keys + i));
+				int found = _mm_movemask_epi8(sizeof(Key) == 2 ? _mm_cmpeq_epi16(block, wanted) : _mm_cmpeq_epi32(block, wanted));
+				if (count - i < lanes) found &= (1 << ((count - i) * sizeof(Key))) - 1;	 // lanes past the end of the array
+				if (found) return true;
+			}
+			return false;
+		}
+#endif
+		return std::binary_search(keys, keys + count, (Key)key);
+	}
+
+	template <typename Key>
+	static void insertSorted(Key *keys, const std::size_t count, const Key key) {
+		Key *at = std::lower_bound(keys, keys + count, key);
+		std::copy_backward(at, keys + count, keys + count + 1);
+		*at = key;
+	}
+
+	template <typename Key>
+	static void eraseSorted(Key *keys, const std::size_t count, const Key key) {
+		Key *at = std::lower_bound(keys, keys + count, key);
+		std::copy(at + 1, keys + count, at);
+	}
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef INCLUDE_PRIME_LABELS_HPP
+#define INCLUDE_PRIME_LABELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// exact reachability index of the compressed divisor graph: y reaches x exactly when x is a factor of y, which is exactly when every
+// prime power p^a of x divides the power of p in y. the label of node n is its prime powers in ascending order of p, and the compressed
+// row of n holds n / p for every prime p of n, so the labels are read off the graph without factorizing anything
+// a query merges two labels of at most 9 prime powers each(a 32 bit int has at most 9 distinct primes) instead of walking the graph,
+// the powers of different primes never divide each other so one division per step tells whether the primes and the powers match
+// every node costs 4 bytes of offset and 4 bytes per distinct prime, about as much as its compressed row
+class PrimeLabelIndex {
+   public:
+	// makes room for the labels of every node after the labelled ones up to lastNode, rowOffsets are the CSR offsets of the compressed graph
+	// the new labels are empty until label() fills them, nodes that are already labelled keep their labels
+	void grow(const int lastNode, const unsigned int *rowOffsets) {
+		if (offsets.empty()) {
+			offsets.reserve(lastNode + 2);	// exactly the first time, growing the graph later grows the labels geometrically
+			offsets.assign(3, 0);			// 0 and 1 have no primes
+		}
+		for (int node = nodeCount() + 1; node <= lastNode; node++) {
+			const unsigned int rowLen = rowOffsets[node + 1] - rowOffsets[node];
+			offsets.push_back(offsets.back() + (rowLen ? rowLen : 1));	// a prime has an empty row and itself as its only prime
+		}
+		primePowers.resize(offsets.back(), 0);
+	}
+
+	// writes the label of node from its compressed row, distinct nodes can be labelled by different threads at once
+	void label(const int node, const int *rowBegin, const int *rowEnd) {
+		uint32_t *powers = primePowers.data() + offsets[node];
+		if (rowBegin == rowEnd) {
+			powers[0] = node;
+			return;
+		}
+
+		// the row is ascending, so node / row is descending and the primes come out in ascending order from the back of the row
+		for (const int *factor = rowEnd; factor-- != rowBegin;) {
+			const int prime = node / *factor;
+			int64_t power = prime;
+			while (node % (power * prime) == 0) power *= prime;
+			*powers++ = power;
+		}
+	}
+
+	// true if x is a factor of y, both must be labelled nodes
+	bool divides(const int x, const int y) const {
+		if (x > y) return false;
+		const uint32_t *xPower = primePowers.data() + offsets[x], *xEnd = primePowers.data() + offsets[x + 1];
+		const uint32_t *yPower = primePowers.data() + offsets[y], *yEnd = primePowers.data() + offsets[y + 1];
+
+		for (; xPower != xEnd; xPower++) {
+			while (yPower != yEnd and *yPower % *xPower != 0) yPower++;	 // the smaller primes of y, and the power of p in y if it is too low
+			if (yPower == yEnd) return false;
+			yPower++;
+		}
+		return true;  // 1 has an empty label and divides everything
+	}
+
+	int nodeCount() const { return offsets.empty() ? 0 : (int)offsets.size() - 2; }
+	std::size_t memoryUsage() const { return offsets.capacity() * sizeof(uint32_t) + primePowers.capacity() * sizeof(uint32_t); }
+
+   private:
+	std::vector<uint32_t> offsets;	// the label of node n is primePowers[offsets[n]] .. primePowers[offsets[n + 1]]
+	std::vector<uint32_t> primePowers;
+};
+
+#endif
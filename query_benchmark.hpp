@@ -0,0 +1,135 @@
+#ifndef INCLUDE_QUERY_BENCHMARK_HPP
+#define INCLUDE_QUERY_BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// which (isThisNumber, aFactorOfThisNumber) pairs a workload asks about, every workload asks about numbers up to totalNodes only
+enum QueryDistribution {
+	UNIFORM_QUERIES,   // y uniform in [2, totalNodes] and x uniform in [1, y], mostly negative like real traffic
+	ZIPF_QUERIES,	   // a small pool of uniform pairs queried over and over with zipfian popularity, the hot pairs are what the cache is for
+	NEGATIVE_QUERIES,  // x is never a factor of y, every bloom filter positive is a false +ve
+	POSITIVE_QUERIES   // x is always a factor of y, the bloom filter can never answer on its own
+};
+
+inline const char *distributionName(const QueryDistribution distribution) {
+	switch (distribution) {
+		case UNIFORM_QUERIES: return "uniform";
+		case ZIPF_QUERIES: return "zipf";
+		case NEGATIVE_QUERIES: return "negative";
+		case POSITIVE_QUERIES: return "positive";
+	}
+	return "unknown";
+}
+
+inline bool parseDistribution(const std::string &name, QueryDistribution &distribution) {
+	for (const QueryDistribution candidate: {UNIFORM_QUERIES, ZIPF_QUERIES, NEGATIVE_QUERIES, POSITIVE_QUERIES})
+		if (name == distributionName(candidate)) {
+			distribution = candidate;
+			return true;
+		}
+	return false;
+}
+
+typedef std::pair<int, int> Query;	// (isThisNumber, aFactorOfThisNumber)
+
+// the same seed always produces the same queries, so runs on different builds answer exactly the same workload
+inline std::vector<Query> generateQueries(const QueryDistribution distribution, const int totalNodes, const int count, const unsigned seed = 42) {
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> node(2, totalNodes);
+	const auto uniformQuery = [&] {
+		const int y = node(rng);
+		return Query(std::uniform_int_distribution<int>(1, y)(rng), y);
+	};
+
+	std::vector<Query> queries;
+	queries.reserve(count);
+
+	if (distribution == ZIPF_QUERIES) {
+		const int hotPairs = 4096, zipfExponent = 1;
+		std::vector<Query> pool(hotPairs);
+		std::vector<double> popularity(hotPairs);
+		for (int rank = 0; rank < hotPairs; rank++) {
+			pool[rank] = uniformQuery();
+			popularity[rank] = 1 / std::pow(rank + 1, zipfExponent);
+		}
+		std::discrete_distribution<int> pickRank(popularity.begin(), popularity.end());
+		while ((int)queries.size() < count) queries.push_back(pool[pickRank(rng)]);
+		return queries;
+	}
+
+	while ((int)queries.size() < count) {
+		if (distribution == POSITIVE_QUERIES) {	 // a random factor of a random y, including 1 and y itself
+			const int y = node(rng);
+			std::vector<int> factors;
+			for (int d = 1; d * d <= y; d++)
+				if (y % d == 0) {
+					factors.push_back(d);
+					if (d * d != y) factors.push_back(y / d);
+				}
+			queries.push_back(Query(factors[std::uniform_int_distribution<int>(0, factors.size() - 1)(rng)], y));
+			continue;
+		}
+
+		const Query query = uniformQuery();
+		if (distribution == NEGATIVE_QUERIES and query.second % query.first == 0) continue;	// only the generator uses %, never the searches
+		queries.push_back(query);
+	}
+	return queries;
+}
+
+struct LatencySummary {
+	double meanNs = 0, p50Ns = 0, p99Ns = 0, p999Ns = 0;
+	double queriesPerSecond = 0;  // of the fastest repetition, measured without timing every query
+	long long positives = 0;	  // answers of one round that were true, also keeps the compiler from dropping the queries
+};
+
+// answers the whole workload warmupRounds times untimed, then repetitions times measuring the throughput of the whole round
+// and repetitions more times measuring the latency of every single query, percentiles are taken over the latencies of every repetition
+template <typename Search>
+LatencySummary measureLatency(const std::vector<Query> &queries, const int warmupRounds, const int repetitions, Search search) {
+	using namespace std::chrono;
+	LatencySummary summary;
+
+	for (int round = 0; round < warmupRounds; round++)
+		for (const Query &query: queries) summary.positives += search(query.first, query.second);
+
+	for (int round = 0; round < repetitions; round++) {
+		long long positives = 0;
+		const auto start = steady_clock::now();
+		for (const Query &query: queries) positives += search(query.first, query.second);
+		const double seconds = duration<double>(steady_clock::now() - start).count();
+		summary.queriesPerSecond = std::max(summary.queriesPerSecond, queries.size() / std::max(seconds, 1e-9));
+		summary.positives = positives;
+	}
+
+	long long positives = 0;
+	std::vector<long long> latencies;
+	latencies.reserve(queries.size() * repetitions);
+	for (int round = 0; round < repetitions; round++)
+		for (const Query &query: queries) {
+			const auto start = steady_clock::now();
+			positives += search(query.first, query.second);
+			latencies.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+		}
+	if (latencies.empty()) return summary;
+	summary.positives = positives / repetitions;
+
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&](const double fraction) { return (double)latencies[std::min(latencies.size() - 1, (std::size_t)(fraction * latencies.size()))]; };
+	double totalNs = 0;
+	for (const long long latency: latencies) totalNs += latency;
+	summary.meanNs = totalNs / latencies.size();
+	summary.p50Ns = percentile(0.50);
+	summary.p99Ns = percentile(0.99);
+	summary.p999Ns = percentile(0.999);
+	return summary;
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef INCLUDE_QUERY_STATS_HPP
+#define INCLUDE_QUERY_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// what happened to the queries of a graph, every stage of searchUsingBloomFilter() counts its outcome
+enum QueryCounter {
+	FILTER_NEGATIVES,	 // the node filter ruled the factor out
+	FILTER_POSITIVES,	 // the node filter said probable true
+	EXACT_POSITIVES,	 // ... from an exact set, so no DFS was needed
+	CACHE_HITS,			 // ... and the pair was a cached false +ve
+	DFS_FALLBACKS,		 // ... and the DFS had to decide
+	DFS_NODES_EXPANDED,	 // by every pruned DFS, not only the fallbacks
+	TRUE_POSITIVES,		 // the factor was confirmed by an exact set or the DFS
+	FALSE_POSITIVES,	 // the filter said probable true but the cache or the DFS said false
+	QUERY_COUNTER_COUNT
+};
+
+// the stages of searchUsingBloomFilter() that are timed, TOTAL_STAGE is the whole query
+enum QueryStage { FILTER_STAGE, CACHE_STAGE, DFS_STAGE, TOTAL_STAGE, QUERY_STAGE_COUNT };
+
+enum StatsFormat {
+	JSON_STATS,		  // one object with the counters, the gauges and the histogram buckets of every stage
+	PROMETHEUS_STATS  // the Prometheus text exposition format, ready to be served or pushed to a gateway
+};
+
+inline const char *queryCounterName(const QueryCounter counter) {
+	static const char *const names[QUERY_COUNTER_COUNT] = {"filter_negatives", "filter_positives", "exact_positives",	"cache_hits",
+														   "dfs_fallbacks",	   "dfs_nodes_expanded", "true_positives", "false_positives"};
+	return names[counter];
+}
+
+inline const char *queryStageName(const QueryStage stage) {
+	static const char *const names[QUERY_STAGE_COUNT] = {"filter", "cache", "dfs", "total"};
+	return names[stage];
+}
+
+// counters and log2 latency histograms of every stage, written by many threads at once without locks
+// every thread is given one of SHARD_COUNT cache line aligned shards the first time it counts something, so threads only share a
+// shard(and pay for the atomic add on a shared line) when there are more than SHARD_COUNT of them, the shards are summed on export
+// nothing is allocated or timed until enable() is called, a disabled QueryStats only costs a predictable branch per call
+// the counters are exact but reading the clock costs as much as a filter query, so only every TIMING_SAMPLE th stage of a thread is timed
+class QueryStats {
+   public:
+	typedef std::chrono::steady_clock Clock;
+	static constexpr int SHARD_COUNT = 64;
+	static constexpr unsigned TIMING_SAMPLE = 16;
+	static constexpr int BUCKET_COUNT = 32;	 // bucket i counts the latencies of 2^i .. 2^(i+1) - 1 Nanoseconds, the last one everything slower
+
+	struct Totals {
+		uint64_t counters[QUERY_COUNTER_COUNT] = {};
+		uint64_t buckets[QUERY_STAGE_COUNT][BUCKET_COUNT] = {};
+		uint64_t stageNs[QUERY_STAGE_COUNT] = {};  // sum of the sampled latencies of every stage
+
+		uint64_t stageCount(const QueryStage stage) const {
+			uint64_t total = 0;
+			for (const uint64_t count: buckets[stage]) total += count;
+			return total;
+		}
+	};
+
+	// every extra metric that is exported next to the counters, eg the build phases or the expected false +ve rate
+	typedef std::vector<std::pair<std::string, double>> Gauges;
+
+	// also drops everything counted so far
+	void enable(const bool on) {
+		shards.reset(on ? new Shard[SHARD_COUNT] : nullptr);
+		enabled = on;
+	}
+
+	bool isEnabled() const { return enabled; }
+
+	void count(const QueryCounter counter, const uint64_t amount = 1) const {
+		if (enabled) shard().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	// the clock is only read while the stats are enabled and the stage is sampled, finish() ignores the stages that are not
+	Clock::time_point start() const {
+		static thread_local unsigned stagesUntilSample = 0;
+		if (not enabled or stagesUntilSample-- != 0) return Clock::time_point();
+		stagesUntilSample = TIMING_SAMPLE - 1;
+		return Clock::now();
+	}
+
+	void finish(const QueryStage stage, const Clock::time_point started) const {
+		if (started == Clock::time_point()) return;
+		const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count();
+		const int bucket = std::min(63 - __builtin_clzll(ns | 1), BUCKET_COUNT - 1);
+		Shard &own = shard();
+		own.buckets[stage][bucket].fetch_add(1, std::memory_order_relaxed);
+		own.stageNs[stage].fetch_add(ns, std::memory_order_relaxed);
+	}
+
+	// a consistent sum only if no other thread is counting, else every counter is at least what it was when totals() was called
+	Totals totals() const {
+		Totals sum;
+		if (not enabled) return sum;
+		for (int i = 0; i < SHARD_COUNT; i++) {
+			for (int c = 0; c < QUERY_COUNTER_COUNT; c++) sum.counters[c] += shards[i].counters[c].load(std::memory_order_relaxed);
+			for (int s = 0; s < QUERY_STAGE_COUNT; s++) {
+				for (int b = 0; b < BUCKET_COUNT; b++) sum.buckets[s][b] += shards[i].buckets[s][b].load(std::memory_order_relaxed);
+				sum.stageNs[s] += shards[i].stageNs[s].load(std::memory_order_relaxed);
+			}
+		}
+		return sum;
+	}
+
+	// false +ve among the queries whose factor was not really a factor, the rate that falsePositivityRateInPC is the target of
+	static double observedFalsePositiveRate(const Totals &totals) {
+		const uint64_t negatives = totals.counters[FALSE_POSITIVES] + totals.counters[FILTER_NEGATIVES];
+		return negatives ? (double)totals.counters[FALSE_POSITIVES] / negatives : 0;
+	}
+
+	void writeJSON(std::ostream &out, const Gauges &gauges) const {
+		const Totals sum = totals();
+		const std::streamsize precision = out.precision(15);	// byte counts as integers rather than 1.02e+07
+		out << "{\n  \"enabled\": " << (enabled ? "true" : "false") << ",\n  \"counters\": {";
+		for (int c = 0; c < QUERY_COUNTER_COUNT; c++) out << (c ? ", " : "") << "\"" << queryCounterName((QueryCounter)c) << "\": " << sum.counters[c];
+		out << "},\n  \"observed_false_positive_rate\": " << observedFalsePositiveRate(sum) << ",\n  \"gauges\": {";
+		for (std::size_t i = 0; i < gauges.size(); i++) out << (i ? ", " : "") << "\"" << gauges[i].first << "\": " << gauges[i].second;
+		out << "},\n  \"stages\": {";
+		for (int s = 0; s < QUERY_STAGE_COUNT; s++) {
+			out << (s ? "," : "") << "\n    \"" << queryStageName((QueryStage)s) << "\": {\"sampled\": " << sum.stageCount((QueryStage)s)
+				<< ", \"sum_ns\": " << sum.stageNs[s] << ", \"log2_ns_buckets\": [";
+			for (int b = 0; b < BUCKET_COUNT; b++) out << (b ? ", " : "") << sum.buckets[s][b];
+			out << "]}";
+		}
+		out << "\n  }\n}\n";
+		out.precision(precision);
+	}
+
+	// the Prometheus text exposition format, the histograms are cumulative with the upper bound of every bucket as le
+	// and only hold the sampled stages, so their _count is about 1 / TIMING_SAMPLE of the counters
+	void writePrometheus(std::ostream &out, const Gauges &gauges) const {
+		const Totals sum = totals();
+		const std::streamsize precision = out.precision(15);	// byte counts as integers rather than 1.02e+07
+		out << "# TYPE dfs_bloom_queries_total counter\n";
+		for (int c = 0; c < QUERY_COUNTER_COUNT; c++) out << "dfs_bloom_queries_total{outcome=\"" << queryCounterName((QueryCounter)c) << "\"} " << sum.counters[c] << "\n";
+		out << "# TYPE dfs_bloom_observed_false_positive_rate gauge\ndfs_bloom_observed_false_positive_rate " << observedFalsePositiveRate(sum) << "\n";
+		for (const std::pair<std::string, double> &gauge: gauges) out << "# TYPE dfs_bloom_" << gauge.first << " gauge\ndfs_bloom_" << gauge.first << " " << gauge.second << "\n";
+
+		out << "# TYPE dfs_bloom_stage_latency_ns histogram\n";
+		for (int s = 0; s < QUERY_STAGE_COUNT; s++) {
+			const char *stage = queryStageName((QueryStage)s);
+			uint64_t cumulative = 0;
+			for (int b = 0; b + 1 < BUCKET_COUNT; b++) {
+				cumulative += sum.buckets[s][b];
+				out << "dfs_bloom_stage_latency_ns_bucket{stage=\"" << stage << "\",le=\"" << ((2ULL << b) - 1) << "\"} " << cumulative << "\n";
+			}
+			out << "dfs_bloom_stage_latency_ns_bucket{stage=\"" << stage << "\",le=\"+Inf\"} " << sum.stageCount((QueryStage)s) << "\n"
+				<< "dfs_bloom_stage_latency_ns_sum{stage=\"" << stage << "\"} " << sum.stageNs[s] << "\n"
+				<< "dfs_bloom_stage_latency_ns_count{stage=\"" << stage << "\"} " << sum.stageCount((QueryStage)s) << "\n";
+		}
+		out.precision(precision);
+	}
+
+   private:
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> counters[QUERY_COUNTER_COUNT] = {};
+		std::atomic<uint64_t> buckets[QUERY_STAGE_COUNT][BUCKET_COUNT] = {};
+		std::atomic<uint64_t> stageNs[QUERY_STAGE_COUNT] = {};
+	};
+
+	bool enabled = false;
+	std::unique_ptr<Shard[]> shards;
+
+	// the shard of the calling thread, the same index in every QueryStats
+	Shard &shard() const {
+		static std::atomic<unsigned> nextShard(0);
+		static thread_local const unsigned own = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+		return shards[own];
+	}
+};
+
+#endif